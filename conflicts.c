@@ -20,6 +20,7 @@
  */
 #include "grammar.h"
 #include "lr0.h"
+#include "stats.h"
 #include "xg.h"
 #include <ulib/log.h>
 
@@ -118,8 +119,22 @@ resolve_shift_reduce_conflict(const xg_symdef *la, const xg_symdef *rm) {
         return xg_resolve_shift_default;
 }
 
+/* Remove the terminal number T from the lookahead set of the
+   reduction RD.  The lookahead sets are shared, so RD gets a new
+   set.  */
+static int
+remove_lookahead(xg_lr0reduct *rd, unsigned int t) {
+    const xg_laset *la;
+
+    if ((la = xg_laset_remove(rd->la, t)) == 0)
+        return -1;
+
+    rd->la = la;
+    return 0;
+}
+
 /* Resolve all shift/reduce conflicts in STATE.  */
-static void
+static int
 resolve_shift_reduce_conflicts(const xg_grammar *g, xg_lr0dfa *dfa, xg_lr0state *state) {
     unsigned int trno;
     unsigned int nrd, rdno;
@@ -151,7 +166,7 @@ resolve_shift_reduce_conflicts(const xg_grammar *g, xg_lr0dfa *dfa, xg_lr0state
             r = xg_resolve_none;
             rd = xg_lr0state_get_reduct(state, rdno);
 
-            if (!ulib_bitset_is_set(&rd->la, la->code))
+            if (!xg_laset_is_set(rd->la, g->termno[la->code]))
                 continue;
 
             /* If the current transition symbol is present as a
@@ -161,16 +176,19 @@ resolve_shift_reduce_conflicts(const xg_grammar *g, xg_lr0dfa *dfa, xg_lr0state
             rm = xg_grammar_get_symbol(g, p->prec);
 
             r = resolve_shift_reduce_conflict(la, rm);
+            xg_stat_add(xg_stat_sr_conflicts, 1);
             if (r == xg_resolve_shift_default || r == xg_resolve_error)
                 log_shift_reduce_conflict(state->id, la, rd, r);
 
-            if (r == xg_resolve_shift || r == xg_resolve_shift_default)
-                ulib_bitset_clear(&rd->la, la->code);
-            else if (r == xg_resolve_reduce) {
+            if (r == xg_resolve_shift || r == xg_resolve_shift_default) {
+                if (remove_lookahead(rd, g->termno[la->code]) < 0)
+                    return -1;
+            } else if (r == xg_resolve_reduce) {
                 xg_lr0state_del_trans(state, trno);
                 break;
             } else if (r == xg_resolve_error) {
-                ulib_bitset_clear(&rd->la, la->code);
+                if (remove_lookahead(rd, g->termno[la->code]) < 0)
+                    return -1;
                 xg_lr0state_del_trans(state, trno);
                 break;
             }
@@ -180,40 +198,60 @@ resolve_shift_reduce_conflicts(const xg_grammar *g, xg_lr0dfa *dfa, xg_lr0state
             || r == xg_resolve_shift_default)
             ++trno;
     }
+
+    return 0;
 }
 
 /* Resolve all reduce/reduce conflicts in STATE.  */
-static void
+static int
 resolve_reduce_reduce_conflicts(const xg_grammar *g, xg_lr0state *state) {
-    unsigned int i, j, n;
-    unsigned int b, bmax;
+    unsigned int i, j, n, b, pos;
     xg_lr0reduct *rdi, *rdj;
+    const xg_laset *small, *other;
     const xg_symdef *def;
 
     n = xg_lr0state_reduct_count(state);
     for (i = 0; i < n; ++i) {
         rdi = xg_lr0state_get_reduct(state, i);
-        bmax = ulib_bitset_max(&rdi->la);
 
         for (j = i + 1; j < n; ++j) {
             rdj = xg_lr0state_get_reduct(state, j);
 
-            for (b = 0; b < bmax; ++b) {
-                if (ulib_bitset_is_set(&rdi->la, b) && ulib_bitset_is_set(&rdj->la, b)) {
-                    def = xg_grammar_get_symbol(g, b);
-                    if (rdi->prod < rdj->prod) {
-                        ulib_bitset_clear(&rdj->la, b);
-                        log_reduce_reduce_conflict(
-                            state->id, def, rdi->prod, rdj->prod, rdi->prod);
-                    } else {
-                        ulib_bitset_clear(&rdi->la, b);
-                        log_reduce_reduce_conflict(
-                            state->id, def, rdi->prod, rdj->prod, rdj->prod);
-                    }
+            /* Walk over the lookaheads of the smaller set and look for
+             them in the other one.  Removing a lookahead gives a
+             reduction a new set, the original sets remain
+             unchanged.  */
+            if (rdi->la->count <= rdj->la->count) {
+                small = rdi->la;
+                other = rdj->la;
+            } else {
+                small = rdj->la;
+                other = rdi->la;
+            }
+
+            pos = 0;
+            while ((b = xg_laset_next(small, &pos)) != XG_LASET_END) {
+                if (!xg_laset_is_set(other, b))
+                    continue;
+
+                def = xg_grammar_get_symbol(g, g->terms[b]);
+                xg_stat_add(xg_stat_rr_conflicts, 1);
+                if (rdi->prod < rdj->prod) {
+                    if (remove_lookahead(rdj, b) < 0)
+                        return -1;
+                    log_reduce_reduce_conflict(
+                        state->id, def, rdi->prod, rdj->prod, rdi->prod);
+                } else {
+                    if (remove_lookahead(rdi, b) < 0)
+                        return -1;
+                    log_reduce_reduce_conflict(
+                        state->id, def, rdi->prod, rdj->prod, rdj->prod);
                 }
             }
         }
     }
+
+    return 0;
 }
 
 /* Resolve parsing conflicts.  */
@@ -230,14 +268,15 @@ xg_resolve_conflicts(const xg_grammar *g, xg_lr0dfa *dfa) {
 
         if ((n = xg_lr0state_reduct_count(state)) != 0) {
             /* Resolve the coflicts.  */
-            resolve_shift_reduce_conflicts(g, dfa, state);
-            resolve_reduce_reduce_conflicts(g, state);
+            if (resolve_shift_reduce_conflicts(g, dfa, state) < 0
+                || resolve_reduce_reduce_conflicts(g, state) < 0)
+                return -1;
 
             /* Remove reductions with empty lookahead sets.  */
             while (n--) {
                 rd = xg_lr0state_get_reduct(state, n);
 
-                if (ulib_bitset_is_empty(&rd->la))
+                if (xg_laset_is_empty(rd->la))
                     xg_lr0state_del_reduct(state, n);
             }
         }
@@ -0,0 +1,371 @@
+/* digraph.c - Propagation of terminal sets over relations.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* The function values are computed with the DIGRAPH algorithm of
+
+   "Efficient Computation of LALR(1) Look-Ahead Sets"
+   Frank DeRemer, Thomas Pennello
+   October 1982
+   ACM Transactions on Programming Languages and Systems (TOPLAS),
+   Volume 4 Issue 4
+ */
+
+#include "digraph.h"
+#include "stats.h"
+#include "xg.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Initialize a digraph of NNODES nodes with empty function values of
+   NWORDS words and an empty relation.  */
+int
+xg_digraph_init(xg_digraph *gr, unsigned int nnodes, unsigned int nwords) {
+    gr->nnodes = nnodes;
+    gr->nwords = nwords;
+    gr->relidx = gr->rel = 0;
+    if ((gr->value = xg_calloc(xg_mem_relation, (size_t)nnodes * nwords + 1, sizeof(xg_termset_word))) == 0)
+        return -1;
+
+    return 0;
+}
+
+/* Release the memory, used by a digraph.  */
+void
+xg_digraph_destroy(xg_digraph *gr) {
+    xg_free(gr->value);
+    xg_free(gr->rel);
+    xg_free(gr->relidx);
+}
+
+/* Replace the relation with the one, given by the XG_DIGRAPH_EDGE
+   elements of EDGES.  The successors of each node are kept in the
+   order of their edges.  */
+int
+xg_digraph_set_relation(xg_digraph *gr, const ulib_vector *edges) {
+    unsigned int i, n, *relidx, *rel;
+    const xg_digraph_edge *e;
+
+    n = ulib_vector_length(edges);
+    relidx = xg_calloc(xg_mem_relation, gr->nnodes + 2, sizeof(unsigned int));
+    rel = xg_malloc(xg_mem_relation, (n + 1) * sizeof(unsigned int));
+    if (relidx == 0 || rel == 0) {
+        xg_free(rel);
+        xg_free(relidx);
+        return -1;
+    }
+
+    /* Count the successors of each node, compute the start of its
+     successors and place the successors.  */
+    e = ulib_vector_front(edges);
+    for (i = 0; i < n; ++i)
+        ++relidx[e[i].src + 2];
+    for (i = 2; i < gr->nnodes + 2; ++i)
+        relidx[i] += relidx[i - 1];
+    for (i = 0; i < n; ++i)
+        rel[relidx[e[i].src + 1]++] = e[i].dst;
+
+    xg_free(gr->rel);
+    xg_free(gr->relidx);
+    gr->relidx = relidx;
+    gr->rel = rel;
+    xg_stat_add(xg_stat_edges, n);
+    return 0;
+}
+
+/* A frame of the depth-first search stack in DIGRAPH computations:
+   a node, the position of its next successor to visit in the
+   relation array and the depth of the SCC stack, after the node
+   was pushed on it.  */
+struct digraph_frame {
+    unsigned int no;
+    unsigned int next;
+    unsigned int depth;
+};
+typedef struct digraph_frame digraph_frame;
+
+/* Context passed around in DIGRAPH computations.  */
+struct digraph_ctx {
+    /* Relation and function values.  */
+    const xg_digraph *gr;
+
+    /* Stack depth at the SCC root (GR->NNODES elements).  */
+    unsigned int *root;
+
+    /* Stack for SCC member candidates (GR->NNODES elements) and its
+       depth.  */
+    unsigned int *stk;
+    unsigned int depth;
+
+    /* Depth-first search stack (GR->NNODES elements).  Each node
+       is on the stack at most once.  */
+    digraph_frame *dfs;
+
+    /* SCC number of each node (GR->NNODES elements) or null, if
+       the function values are computed during the search.  */
+    unsigned int *scc;
+
+    /* Number of SCCs, members of all the SCCs in the order of
+       discovery (GR->NNODES elements) and position of the first member
+       of each SCC (NSCC + 1 elements).  */
+    unsigned int nscc;
+    unsigned int *member;
+    unsigned int *first;
+
+    /* SCCs, whose function values are computed by the current parallel
+       run.  */
+    const unsigned int *batch;
+};
+typedef struct digraph_ctx digraph_ctx;
+
+/* Visit the nodes, reachable from START, in DFS order over the
+   relation.  The search uses an explicit stack, so the depth of the
+   relation graph is not limited by the native stack size.  */
+static void
+digraph_visit(digraph_ctx *ctx, unsigned int start) {
+    unsigned int no, n, top, nwords;
+    const unsigned int *next;
+    const xg_digraph *gr = ctx->gr;
+    digraph_frame *f;
+
+    /* Push the node on the stacks.  It's a candidate for an SCC
+     root.  Record the current stack depth.  */
+    nwords = gr->nwords;
+    ctx->stk[ctx->depth++] = start;
+    ctx->root[start] = ctx->depth;
+    ctx->dfs[0].no = start;
+    ctx->dfs[0].next = gr->relidx[start];
+    ctx->dfs[0].depth = ctx->depth;
+    top = 1;
+
+    while (top != 0) {
+        f = &ctx->dfs[top - 1];
+        no = f->no;
+
+        /* Traverse the sucessors of the current node.  */
+        n = gr->relidx[no + 1];
+        next = gr->rel + f->next;
+        for (; f->next < n; ++f->next, ++next) {
+            if (ctx->root[*next] == 0) {
+                /* Descend into the successor, the current one will be
+                 revisited on return.  */
+                ctx->stk[ctx->depth++] = *next;
+                ctx->root[*next] = ctx->depth;
+                ctx->dfs[top].no = *next;
+                ctx->dfs[top].next = gr->relidx[*next];
+                ctx->dfs[top].depth = ctx->depth;
+                ++top;
+                break;
+            }
+
+            if (ctx->root[*next] < ctx->root[no]) {
+                /* Current node is a part of an SCC, whose root is
+                 deeper in the stack.  */
+                ctx->root[no] = ctx->root[*next];
+            }
+
+            if (ctx->scc == 0)
+                xg_termset_or(xg_digraph_value(gr, no), xg_digraph_value(gr, *next), nwords);
+        }
+
+        if (f->next < n)
+            continue;
+
+        if (ctx->root[no] == f->depth && ctx->scc != 0) {
+            /* Found an SCC, record its members.  */
+            do {
+                n = ctx->stk[--ctx->depth];
+                ctx->root[n] = ~0U;
+                ctx->scc[n] = ctx->nscc;
+                ctx->member[ctx->first[ctx->nscc + 1]++] = n;
+            } while (n != no);
+            ++ctx->nscc;
+            ctx->first[ctx->nscc + 1] = ctx->first[ctx->nscc];
+            xg_stat_add(xg_stat_sccs, 1);
+        } else if (ctx->root[no] == f->depth) {
+            /* Found an SCC, with the current node being the root
+             and the nodes up the stack being the SCC members.
+             Pop the entire SCC. */
+            do {
+                n = ctx->stk[--ctx->depth];
+                ctx->root[n] = ~0U;
+                if (n != no)
+                    xg_termset_copy(xg_digraph_value(gr, n), xg_digraph_value(gr, no), nwords);
+            } while (n != no);
+            xg_stat_add(xg_stat_sccs, 1);
+        }
+
+        /* Return to the predecessor.  */
+        --top;
+    }
+}
+
+/* Compute the function F x = F'x U U{F'y | x R y} on the directed
+   graph defined by the relation R.  */
+static void
+digraph(digraph_ctx *ctx) {
+    unsigned int i, n;
+
+    n = ctx->gr->nnodes;
+    for (i = 0; i < n; ++i)
+        if (ctx->root[i] == 0)
+            digraph_visit(ctx, i);
+}
+
+/* Compute the function value of the SCC number N of the current batch.
+   The value is computed in the first member of the SCC and copied to
+   the others.  The successor SCCs are already done.  */
+static int
+digraph_scc_value(void *arg, unsigned int thread __attribute__((unused)), unsigned int n) {
+    unsigned int c, i, j, x, nwords;
+    xg_termset_word *value;
+    const digraph_ctx *ctx = arg;
+    const xg_digraph *gr = ctx->gr;
+
+    nwords = gr->nwords;
+    c = ctx->batch[n];
+    value = xg_digraph_value(gr, ctx->member[ctx->first[c]]);
+    for (i = ctx->first[c]; i < ctx->first[c + 1]; ++i) {
+        x = ctx->member[i];
+        if (i != ctx->first[c])
+            xg_termset_or(value, xg_digraph_value(gr, x), nwords);
+
+        for (j = gr->relidx[x]; j < gr->relidx[x + 1]; ++j) {
+            if (ctx->scc[gr->rel[j]] != c)
+                xg_termset_or(value, xg_digraph_value(gr, gr->rel[j]), nwords);
+        }
+    }
+
+    for (i = ctx->first[c] + 1; i < ctx->first[c + 1]; ++i)
+        xg_termset_copy(xg_digraph_value(gr, ctx->member[i]), value, nwords);
+
+    return 0;
+}
+
+/* Compute the function F, like DIGRAPH, using the threads of POOL.
+   First find the SCCs of the relation graph, then process the
+   condensation DAG level by level, starting from the SCCs without
+   successors.  The values of the SCCs at the same level do not depend
+   on each other and are computed concurrently.  */
+static int
+digraph_parallel(digraph_ctx *ctx, xg_pool *pool) {
+    int sts = -1;
+    unsigned int c, i, j, x, lvl, nlvl, *level, *order, *start;
+    const xg_digraph *gr = ctx->gr;
+
+    /* Find the SCCs.  Each SCC is found after all of its successors.  */
+    ctx->nscc = 0;
+    ctx->first[0] = ctx->first[1] = 0;
+    digraph(ctx);
+
+    level = xg_malloc(xg_mem_relation, (ctx->nscc + 1) * sizeof(unsigned int));
+    order = xg_malloc(xg_mem_relation, (ctx->nscc + 1) * sizeof(unsigned int));
+    start = xg_calloc(xg_mem_relation, ctx->nscc + 2, sizeof(unsigned int));
+    if (level == 0 || order == 0 || start == 0)
+        goto exit;
+
+    /* Compute the level of each SCC: one more than the maximum level
+       of its successors.  */
+    nlvl = 0;
+    for (c = 0; c < ctx->nscc; ++c) {
+        lvl = 0;
+        for (i = ctx->first[c]; i < ctx->first[c + 1]; ++i) {
+            x = ctx->member[i];
+            for (j = gr->relidx[x]; j < gr->relidx[x + 1]; ++j) {
+                if (ctx->scc[gr->rel[j]] != c && level[ctx->scc[gr->rel[j]]] >= lvl)
+                    lvl = level[ctx->scc[gr->rel[j]]] + 1;
+            }
+        }
+        level[c] = lvl;
+        if (lvl >= nlvl)
+            nlvl = lvl + 1;
+        ++start[lvl + 2];
+    }
+
+    /* Sort the SCCs by level.  */
+    for (lvl = 2; lvl <= nlvl + 1; ++lvl)
+        start[lvl] += start[lvl - 1];
+    for (c = 0; c < ctx->nscc; ++c)
+        order[start[level[c] + 1]++] = c;
+
+    /* Compute the values, one level at a time.  */
+    for (lvl = 0; lvl < nlvl; ++lvl) {
+        ctx->batch = order + start[lvl];
+        if (xg_pool_run(pool, start[lvl + 1] - start[lvl], digraph_scc_value, ctx) < 0)
+            goto exit;
+    }
+
+    sts = 0;
+
+exit:
+    xg_free(start);
+    xg_free(order);
+    xg_free(level);
+    return sts;
+}
+
+/* Compute the function F x = F'x U U{F y | x R y}, where F' are the
+   current function values, with DIGRAPH or, if POOL is not null, with
+   DIGRAPH_PARALLEL.  */
+int
+xg_digraph_run(xg_digraph *gr, xg_pool *pool) {
+    int sts = -1;
+    unsigned int n;
+    digraph_ctx ctx;
+
+    n = gr->nnodes + 1;
+    ctx.gr = gr;
+    ctx.depth = 0;
+    ctx.stk = xg_malloc(xg_mem_relation, n * sizeof(unsigned int));
+    ctx.dfs = xg_malloc(xg_mem_relation, n * sizeof(digraph_frame));
+    ctx.root = xg_calloc(xg_mem_relation, n, sizeof(unsigned int));
+    ctx.scc = ctx.member = ctx.first = 0;
+    if (pool) {
+        ctx.scc = xg_malloc(xg_mem_relation, n * sizeof(unsigned int));
+        ctx.member = xg_malloc(xg_mem_relation, n * sizeof(unsigned int));
+        ctx.first = xg_malloc(xg_mem_relation, (n + 1) * sizeof(unsigned int));
+    }
+
+    if (ctx.stk && ctx.dfs && ctx.root && (pool == 0 || (ctx.scc && ctx.member && ctx.first))) {
+        if (pool)
+            sts = digraph_parallel(&ctx, pool);
+        else {
+            digraph(&ctx);
+            sts = 0;
+        }
+    }
+
+    xg_free(ctx.first);
+    xg_free(ctx.member);
+    xg_free(ctx.scc);
+    xg_free(ctx.root);
+    xg_free(ctx.dfs);
+    xg_free(ctx.stk);
+    if (sts < 0)
+        ulib_log_printf(xg_log, "ERROR: Unable to propagate the relation values");
+    return sts;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
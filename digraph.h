@@ -0,0 +1,87 @@
+/* digraph.h - Propagation of terminal sets over relations.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef xg__digraph_h
+#define xg__digraph_h 1
+
+#include "pool.h"
+#include "termset.h"
+#include <ulib/vector.h>
+
+BEGIN_DECLS
+
+/* An edge of a relation, while the relation is being constructed.  */
+struct xg_digraph_edge {
+    unsigned int src;
+    unsigned int dst;
+};
+typedef struct xg_digraph_edge xg_digraph_edge;
+
+/* A relation R on the nodes 0, 1, ..., NNODES - 1 and a function value
+   for each node.  */
+struct xg_digraph {
+    /* Number of nodes.  */
+    unsigned int nnodes;
+
+    /* Related nodes, in compressed sparse row form: the nodes, related
+       to the node N, are REL[RELIDX[N]], ..., REL[RELIDX[N + 1] - 1].  */
+    unsigned int *relidx;
+    unsigned int *rel;
+
+    /* Function values, terminal sets of NWORDS words for each node, in
+       a single block.  */
+    unsigned int nwords;
+    xg_termset_word *value;
+};
+typedef struct xg_digraph xg_digraph;
+
+/* Initialize a digraph of NNODES nodes with empty function values of
+   NWORDS words and an empty relation.  */
+int xg_digraph_init(xg_digraph *gr, unsigned int nnodes, unsigned int nwords);
+
+/* Release the memory, used by a digraph.  */
+void xg_digraph_destroy(xg_digraph *gr);
+
+/* Get the function value of the node N.  */
+static inline xg_termset_word *
+xg_digraph_value(const xg_digraph *gr, unsigned int n) {
+    return gr->value + (size_t)n * gr->nwords;
+}
+
+/* Replace the relation with the one, given by the XG_DIGRAPH_EDGE
+   elements of EDGES.  The successors of each node are kept in the
+   order of their edges.  */
+int xg_digraph_set_relation(xg_digraph *gr, const ulib_vector *edges);
+
+/* Compute the function F x = F'x U U{F y | x R y}, where F' are the
+   current function values.  If POOL is not null, use its threads.  */
+int xg_digraph_run(xg_digraph *gr, xg_pool *pool);
+
+END_DECLS
+
+#endif /* xg__digraph_h */
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -19,145 +19,383 @@
  * along with XG; if not, write to the Free Software Foundation,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.  
  */
+#include "digraph.h"
 #include "grammar.h"
 #include "xg.h"
+#include <string.h>
 
-const ulib_bitset *xg_epsilon_set;
-const ulib_bitset *xg_eof_set;
+/* Create a terminal set, containing only the empty symbol.  */
+static xg_termset_word *
+epsilon_set(const xg_grammar *g) {
+    xg_termset_word *set;
 
-/* Compute the FIRST set for each non-terminal.  */
-int
-xg_grammar_compute_first(const xg_grammar *g) {
-    int chg, sts;
-    unsigned int i, j, n, m;
+    if ((set = xg_calloc(xg_mem_sets, g->termset_words, sizeof(xg_termset_word))) != 0)
+        xg_termset_set(set, g->termno[XG_EPSILON]);
+
+    return set;
+}
+
+/* Productions, which refer to each non-terminal in the right hand
+   side.  The productions, which refer to the symbol S, are PROD[START[S]],
+   ..., PROD[START[S + 1] - 1], each one listed once.  */
+struct prod_uses {
+    unsigned int *start;
+    unsigned int *prod;
+};
+
+/* Create the index of the productions, referring to each non-terminal.  */
+static int
+make_prod_uses(const xg_grammar *g, struct prod_uses *u) {
+    unsigned int i, j, n, m, nsyms, *last;
+    xg_sym sym;
+    const xg_prod *p;
+
+    nsyms = xg_grammar_symbol_count(g);
+    n = xg_grammar_prod_count(g);
+    u->prod = 0;
+    if ((u->start = xg_calloc(xg_mem_sets, nsyms + 2, sizeof(unsigned int))) == 0
+        || (last = xg_malloc(xg_mem_sets, nsyms * sizeof(unsigned int))) == 0)
+        return -1;
+
+    /* Count the productions, referring to each symbol, at START[S + 2],
+       then turn the counts into the starting positions at START[S + 1]
+       and fill in the productions, advancing START[S + 1] to the end
+       position, which is the starting position of S + 1.  */
+    memset(last, 0xff, nsyms * sizeof(unsigned int));
+    for (i = 0; i < n; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        m = xg_prod_length(p);
+        for (j = 0; j < m; ++j) {
+            sym = xg_prod_get_symbol(p, j);
+            if (!xg_grammar_is_terminal_sym(g, sym) && last[sym] != i) {
+                last[sym] = i;
+                ++u->start[sym + 2];
+            }
+        }
+    }
+
+    for (i = 2; i < nsyms + 2; ++i)
+        u->start[i] += u->start[i - 1];
+
+    if ((u->prod = xg_malloc(xg_mem_sets, (u->start[nsyms + 1] + 1) * sizeof(unsigned int))) == 0) {
+        xg_free(last);
+        return -1;
+    }
+
+    memset(last, 0xff, nsyms * sizeof(unsigned int));
+    for (i = 0; i < n; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        m = xg_prod_length(p);
+        for (j = 0; j < m; ++j) {
+            sym = xg_prod_get_symbol(p, j);
+            if (!xg_grammar_is_terminal_sym(g, sym) && last[sym] != i) {
+                last[sym] = i;
+                u->prod[u->start[sym + 1]++] = i;
+            }
+        }
+    }
+
+    xg_free(last);
+    return 0;
+}
+
+/* Add to FIRST (X) the contribution of the production P, with a left
+   hand side X.  Return non-zero if FIRST (X) changed.  */
+static int
+update_first(const xg_grammar *g, const xg_prod *p, const xg_termset_word *eps_set) {
+    int chg = 0;
+    unsigned int j, m, eps;
     xg_sym sym;
-    xg_prod *p;
     xg_symdef *ls, *rs;
 
+    eps = g->termno[XG_EPSILON];
+    ls = xg_grammar_get_symbol(g, p->lhs);
+    m = xg_prod_length(p);
+
+    /* For each production X -> Y1 Y2 Y3 ... Yn, add to FIRST(X) each
+       symbol in FIRST (Yi) iff epsilon is in each FIRST(Yi-1).  Add
+       epsilon to FIRST (X) iff epsilon is in each FIRST (Yi), which
+       includes the production X -> epsilon.  */
+    for (j = 0; j < m; ++j) {
+        sym = xg_prod_get_symbol(p, j);
+        if (xg_grammar_is_terminal_sym(g, sym)) {
+            if (!xg_termset_is_set(ls->first, g->termno[sym])) {
+                chg = 1;
+                xg_termset_set(ls->first, g->termno[sym]);
+            }
+            return chg;
+        }
+
+        rs = xg_grammar_get_symbol(g, sym);
+        if (ls != rs && xg_termset_or_andn_chg(ls->first, rs->first, eps_set, g->termset_words))
+            chg = 1;
+        if (!xg_termset_is_set(rs->first, eps))
+            return chg;
+    }
+
+    if (!xg_termset_is_set(ls->first, eps)) {
+        chg = 1;
+        xg_termset_set(ls->first, eps);
+    }
+
+    return chg;
+}
+
+/* Compute the FIRST set for each non-terminal.  FIRST (X) depends only
+   on the FIRST sets of the symbols in the right hand sides of the
+   productions for X, thus a production needs to be revisited only when
+   the FIRST set of one of its right hand side symbols changes.  The
+   pending productions are kept in a FIFO queue, each one at most
+   once.  */
+int
+xg_grammar_compute_first(const xg_grammar *g) {
+    unsigned int i, k, n, head, len, *queue = 0;
+    unsigned char *queued = 0;
+    xg_termset_word *eps_set;
+    const xg_prod *p;
+    struct prod_uses uses = {0, 0};
+
     n = xg_grammar_prod_count(g);
-    chg = 1;
-    while (chg) {
-        chg = 0;
-        for (i = 0; i < n; ++i) {
-            p = xg_grammar_get_prod(g, i);
-            ls = xg_grammar_get_symbol(g, p->lhs);
-            m = xg_prod_length(p);
-            if (m == 0) {
-                /* For each production X -> epsilon, add epsilon to
-                 FIRST (X).  */
-                chg = chg || !ulib_bitset_is_set(&ls->first, XG_EPSILON);
-                if (ulib_bitset_set(&ls->first, XG_EPSILON) < 0)
-                    goto error;
-            } else {
-                /* For each production X -> Y1 Y2 Y3 ... Yn, add to
-                 FIRST(A) each symbol in FIRST (Yi) iff epsilon is in
-                 each FIRST(Yi-1).  Add epsilon to FIRST (Y) iff
-                 epsilon is in each FIRST (Yi).  */
-                for (j = 0; j < m; ++j) {
-                    sym = xg_prod_get_symbol(p, j);
-                    if (xg_grammar_is_terminal_sym(g, sym)) {
-                        if (!ulib_bitset_is_set(&ls->first, sym)) {
-                            chg = 1;
-                            if (ulib_bitset_set(&ls->first, sym) < 0)
-                                goto error;
-                        }
-                        break;
-                    } else {
-                        rs = xg_grammar_get_symbol(g, sym);
-                        if (ls != rs) {
-                            sts = ulib_bitset_destr_or_andn_chg(
-                                &ls->first, &rs->first, xg_epsilon_set);
-                            if (sts < 0)
-                                goto error;
-                            chg = chg || (sts > 0);
-                        }
-                        if (!ulib_bitset_is_set(&rs->first, XG_EPSILON))
-                            break;
-                    }
-                }
-
-                if (j == m && ulib_bitset_set(&ls->first, XG_EPSILON) < 0)
-                    goto error;
+    if ((eps_set = epsilon_set(g)) == 0 || make_prod_uses(g, &uses) < 0
+        || (queue = xg_malloc(xg_mem_sets, (n + 1) * sizeof(unsigned int))) == 0
+        || (queued = xg_malloc(xg_mem_sets, n + 1)) == 0)
+        goto error;
+
+    for (i = 0; i < n; ++i)
+        queue[i] = i;
+    memset(queued, 1, n);
+
+    head = 0;
+    len = n;
+    while (len != 0) {
+        i = queue[head];
+        head = head + 1 == n ? 0 : head + 1;
+        --len;
+        queued[i] = 0;
+
+        p = xg_grammar_get_prod(g, i);
+        if (!update_first(g, p, eps_set))
+            continue;
+
+        /* FIRST (X) changed, revisit the productions, which refer to
+           X.  */
+        for (k = uses.start[p->lhs]; k < uses.start[p->lhs + 1]; ++k) {
+            i = uses.prod[k];
+            if (!queued[i]) {
+                queued[i] = 1;
+                queue[head + len < n ? head + len : head + len - n] = i;
+                ++len;
             }
         }
     }
 
+    xg_free(queued);
+    xg_free(queue);
+    xg_free(uses.prod);
+    xg_free(uses.start);
+    xg_free(eps_set);
     return 0;
 
 error:
+    xg_free(queued);
+    xg_free(queue);
+    xg_free(uses.prod);
+    xg_free(uses.start);
+    xg_free(eps_set);
     ulib_log_printf(xg_log, "ERROR: Out of memory computing FIRST sets");
     return -1;
 }
 
-/* Compute the FOLLOW set for each non-terminal.  */
+/* Release the FIRST sets of the non-terminals.  */
+void
+xg_grammar_release_first(xg_grammar *g) {
+    unsigned int i, n;
+
+    n = xg_grammar_symbol_count(g);
+    for (i = XG_TOKEN_LITERAL_MAX + 1; i < n; ++i)
+        if (!xg_grammar_is_terminal_sym(g, i))
+            xg_grammar_get_symbol(g, i)->first = 0;
+    xg_free(g->first_sets);
+    g->first_sets = 0;
+}
+
+/* Compute the nullable flag and the FIRST set of each production
+   suffix, from the last position of each production to the first.  The
+   FIRST set is a prerequisite for calling this function.  */
 int
-xg_grammar_compute_follow(const xg_grammar *g) {
-    int chg, sts;
-    unsigned int i, j, k, n, m;
-    xg_prod *p;
-    xg_symdef *ls, *rs, *fs;
+xg_grammar_compute_suffixes(xg_grammar *g) {
+    int nullable, chg;
+    unsigned int i, j, n, m, nw;
     xg_sym sym;
+    const xg_prod *p;
+    const xg_symdef *def;
+    xg_termset_word *eps_set, *set = 0;
+
+    nw = g->termset_words;
+    xg_free(g->suffix_nullable);
+    xg_free(g->suffix_first);
+    g->suffix_first = 0;
+    if ((eps_set = epsilon_set(g)) == 0
+        || (set = xg_malloc(xg_mem_sets, (nw + 1) * sizeof(xg_termset_word))) == 0
+        || (g->suffix_nullable = xg_malloc(xg_mem_sets, g->nitems + 1)) == 0
+        || (g->suffix_first = xg_malloc(xg_mem_sets, (g->nitems + 1) * sizeof(xg_laset *))) == 0)
+        goto error;
 
     n = xg_grammar_prod_count(g);
-    chg = 1;
-    while (chg) {
-        chg = 0;
-        for (i = 0; i < n; ++i) {
-            /* For each production X -> aYc, add to FOLLOW(Y) all the
-             symbols in FIRST(c), except epsilon. If c derives
-             epsilon, add FOLLOW(X) to FOLLOW(Y).  */
-            p = xg_grammar_get_prod(g, i);
-            ls = xg_grammar_get_symbol(g, p->lhs);
-            m = xg_prod_length(p);
-            for (j = 0; j < m; ++j) {
-                /* Update FOLLOW (RS).  */
-                sym = xg_prod_get_symbol(p, j);
-                if (xg_grammar_is_terminal_sym(g, sym))
-                    continue;
-                rs = xg_grammar_get_symbol(g, sym);
-
-                for (k = j + 1; k < m; ++k) {
-                    sym = xg_prod_get_symbol(p, k);
-                    if (xg_grammar_is_terminal_sym(g, sym)) {
-                        /* Add the terminal SYM to FOLLOW (RS).  */
-                        if (!ulib_bitset_is_set(&rs->follow, sym)) {
-                            chg = 1;
-                            if (ulib_bitset_set(&rs->follow, sym) < 0)
-                                goto error;
-                        }
-                        break;
-                    } else {
-                        /* Add all the symbols in FIRST (FS) to FOLLOW
-                         (RS).  */
-                        fs = xg_grammar_get_symbol(g, sym);
-                        sts = ulib_bitset_destr_or_andn_chg(
-                            &rs->follow, &fs->first, xg_epsilon_set);
-                        if (sts < 0)
-                            goto error;
-                        chg = chg || (sts > 0);
-                        if (!ulib_bitset_is_set(&fs->first, XG_EPSILON))
-                            break;
-                    }
-                }
-
-                if (k >= m && ls != rs) {
-                    /* Add FOLLOW(LS) to FOLLOW(RS).  */
-                    sts = ulib_bitset_destr_or_chg(&rs->follow, &ls->follow);
-                    if (sts < 0)
-                        goto error;
-                    chg = chg || (sts > 0);
-                }
+    for (i = 0; i < n; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        m = xg_prod_length(p);
+
+        /* The empty suffix.  */
+        memset(set, 0, nw * sizeof(xg_termset_word));
+        nullable = 1;
+        g->suffix_nullable[p->item + m] = 1;
+        g->suffix_first[p->item + m] = xg_empty_laset;
+
+        /* FIRST (Y c) is FIRST (Y), without epsilon, and FIRST (c) if
+           Y is nullable.  Y c is nullable iff both Y and c are.  */
+        for (j = m; j-- > 0;) {
+            sym = xg_prod_get_symbol(p, j);
+            if (xg_grammar_is_terminal_sym(g, sym)) {
+                memset(set, 0, nw * sizeof(xg_termset_word));
+                xg_termset_set(set, g->termno[sym]);
+                nullable = 0;
+                chg = 1;
+            } else {
+                def = xg_grammar_get_symbol(g, sym);
+                if (!xg_termset_is_set(def->first, g->termno[XG_EPSILON])) {
+                    memset(set, 0, nw * sizeof(xg_termset_word));
+                    nullable = 0;
+                    chg = 1;
+                } else
+                    chg = 0;
+                chg = xg_termset_or_andn_chg(set, def->first, eps_set, nw) || chg;
             }
+
+            g->suffix_nullable[p->item + j] = nullable;
+            if (!chg)
+                g->suffix_first[p->item + j] = g->suffix_first[p->item + j + 1];
+            else if ((g->suffix_first[p->item + j] = xg_laset_intern(set, nw)) == 0)
+                goto error;
         }
     }
 
+    xg_free(set);
+    xg_free(eps_set);
     return 0;
 
 error:
-    ulib_log_printf(xg_log, "ERROR: Out of memory computing FOLLOW sets");
+    xg_free(set);
+    xg_free(eps_set);
+    ulib_log_printf(xg_log, "ERROR: Out of memory computing production suffixes");
     return -1;
 }
 
+/* Release the nullable flags and the FIRST sets of the production
+   suffixes.  */
+void
+xg_grammar_release_suffixes(xg_grammar *g) {
+    xg_free(g->suffix_nullable);
+    xg_free(g->suffix_first);
+    g->suffix_nullable = 0;
+    g->suffix_first = 0;
+}
+
+/* Compute the FOLLOW set for each non-terminal.  For each production
+   X -> aYc, FOLLOW (Y) contains FIRST (c), except epsilon, and, if c
+   derives epsilon, FOLLOW (X).  The former are the initial values of
+   the FOLLOW sets, the latter is a relation between the non-terminals,
+   along which the sets are propagated in a single DIGRAPH run.  */
+int
+xg_grammar_compute_follow(const xg_grammar *g) {
+    int sts = -1;
+    unsigned int i, j, n, m, nsyms, nnts, nw, *node = 0;
+    xg_sym sym, *nts = 0;
+    const xg_prod *p;
+    xg_digraph gr;
+    xg_digraph_edge e;
+    ulib_vector edges;
+
+    (void)ulib_vector_init(&edges, ULIB_ELT_SIZE, sizeof(xg_digraph_edge), 0);
+    gr.value = 0;
+    gr.relidx = gr.rel = 0;
+
+    nw = g->termset_words;
+    nsyms = xg_grammar_symbol_count(g);
+    if ((node = xg_malloc(xg_mem_sets, nsyms * sizeof(unsigned int))) == 0
+        || (nts = xg_malloc(xg_mem_sets, nsyms * sizeof(xg_sym))) == 0)
+        goto exit;
+
+    /* Number the non-terminals densely, these are the nodes of the
+     relation.  */
+    nnts = 0;
+    for (i = XG_TOKEN_LITERAL_MAX + 1; i < nsyms; ++i) {
+        if (!xg_grammar_is_terminal_sym(g, i)) {
+            node[i] = nnts;
+            nts[nnts++] = i;
+        }
+    }
+
+    if (xg_digraph_init(&gr, nnts, nw) < 0)
+        goto exit;
+    for (i = 0; i < nnts; ++i)
+        xg_termset_copy(xg_digraph_value(&gr, i), xg_grammar_get_symbol(g, nts[i])->follow, nw);
+
+    n = xg_grammar_prod_count(g);
+    for (i = 0; i < n; ++i) {
+        /* For each production X -> aYc, add to FOLLOW(Y) all the
+         symbols in FIRST(c), except epsilon.  If c derives epsilon,
+         relate Y to X.  */
+        p = xg_grammar_get_prod(g, i);
+        m = xg_prod_length(p);
+        for (j = 0; j < m; ++j) {
+            /* Update FOLLOW (RS).  */
+            sym = xg_prod_get_symbol(p, j);
+            if (xg_grammar_is_terminal_sym(g, sym))
+                continue;
+
+            xg_laset_or(xg_digraph_value(&gr, node[sym]), xg_prod_first_suffix(g, p, j + 1));
+            if (xg_prod_nullable_suffix(g, p, j + 1) && sym != p->lhs) {
+                /* FOLLOW(SYM) includes FOLLOW(LHS).  */
+                e.src = node[sym];
+                e.dst = node[p->lhs];
+                if (ulib_vector_append(&edges, &e) < 0)
+                    goto exit;
+            }
+        }
+    }
+
+    if (xg_digraph_set_relation(&gr, &edges) < 0 || xg_digraph_run(&gr, 0) < 0)
+        goto exit;
+
+    for (i = 0; i < nnts; ++i)
+        xg_termset_copy(xg_grammar_get_symbol(g, nts[i])->follow, xg_digraph_value(&gr, i), nw);
+
+    sts = 0;
+
+exit:
+    xg_digraph_destroy(&gr);
+    ulib_vector_destroy(&edges);
+    xg_free(nts);
+    xg_free(node);
+    if (sts < 0)
+        ulib_log_printf(xg_log, "ERROR: Out of memory computing FOLLOW sets");
+    return sts;
+}
+
+/* Release the FOLLOW sets of the non-terminals.  */
+void
+xg_grammar_release_follow(xg_grammar *g) {
+    unsigned int i, n;
+
+    n = xg_grammar_symbol_count(g);
+    for (i = XG_TOKEN_LITERAL_MAX + 1; i < n; ++i)
+        if (!xg_grammar_is_terminal_sym(g, i))
+            xg_grammar_get_symbol(g, i)->follow = 0;
+    xg_free(g->follow_sets);
+    g->follow_sets = 0;
+}
+
 /* Check whether the symbol S is nullable.  */
 int
 xg_nullable_sym(const xg_grammar *g, xg_sym s) {
@@ -170,7 +408,7 @@ xg_nullable_sym(const xg_grammar *g, xg_sym s) {
         return 0;
 
     def = xg_grammar_get_symbol(g, s);
-    return ulib_bitset_is_set(&def->first, XG_EPSILON);
+    return xg_termset_is_set(def->first, g->termno[XG_EPSILON]);
 }
 
 /* Check whether the sentenial form FORM can derive the empty string.
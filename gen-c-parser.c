@@ -22,7 +22,11 @@
 #include "grammar.h"
 #include <ulib/vector.h>
 #include "lr0.h"
+#include "gen-parser.h"
+#include "stats.h"
+#include "xg.h"
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 /* Generation of switch statements for reduce actions and non-terminal
@@ -31,12 +35,12 @@
    is used to record destination frequencies.  */
 struct freq {
     unsigned int dst;
-    unsigned int freq;
+    unsigned long freq;
 };
 
-/* Increment the frequency for DST.  */
+/* Add CNT to the frequency for DST.  */
 static int
-increment_freq(ulib_vector *vec, unsigned int dst) {
+add_freq(ulib_vector *vec, unsigned int dst, unsigned long cnt) {
     unsigned int n;
     struct freq *fq;
 
@@ -44,7 +48,7 @@ increment_freq(ulib_vector *vec, unsigned int dst) {
     fq = ulib_vector_front(vec);
     while (n--) {
         if (fq->dst == dst) {
-            ++fq->freq;
+            fq->freq += cnt;
             return 0;
         }
         ++fq;
@@ -56,7 +60,7 @@ increment_freq(ulib_vector *vec, unsigned int dst) {
     fq = ulib_vector_back(vec);
 
     fq[-1].dst = dst;
-    fq[-1].freq = 1;
+    fq[-1].freq = cnt;
 
     return 0;
 }
@@ -64,7 +68,8 @@ increment_freq(ulib_vector *vec, unsigned int dst) {
 /* Find the destination with maximum frequency.  */
 static unsigned int
 max_freq(ulib_vector *vec) {
-    unsigned int n, mx, dst;
+    unsigned int n, dst;
+    unsigned long mx;
     struct freq *fq;
 
     mx = 0;
@@ -82,21 +87,13 @@ max_freq(ulib_vector *vec) {
     return dst;
 }
 
-int
-xg_gen_c_parser(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa) {
-    xg_sym sym, k;
-    unsigned int i, j, n, m, dst;
-    const xg_lr0state *state;
-    const xg_lr0trans *tr;
-    const xg_lr0reduct *rd;
+/* Output the names of the symbols and the productions, used by the
+   debugging code of a parser.  */
+void
+xg_gen_c_debug_names(FILE *out, const xg_grammar *g) {
+    unsigned int i, n;
     const xg_prod *p;
     const xg_symdef *def;
-    ulib_vector casevec;
-
-    (void)ulib_vector_init(&casevec, ULIB_ELT_SIZE, sizeof(struct freq), 0);
-
-    /* Include the common parser declarations.  */
-    fputs("#include <xg-c-parser.h>\n\n", out);
 
     /* Emit symbol names.  */
     fputs("#ifndef NDEBUG\n", out);
@@ -125,18 +122,801 @@ xg_gen_c_parser(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa) {
     }
     fputs("  0\n};\n\n", out);
     fputs("#endif /* NDEBUG */\n\n", out);
+}
+
+/* Get the number of the non-terminals of the grammar G, except the
+   start symbol.  */
+static unsigned int
+nonterminal_count(const xg_grammar *g) {
+    unsigned int n;
+    xg_sym sym, k;
+
+    n = 0;
+    k = xg_grammar_symbol_count(g);
+    for (sym = XG_TOKEN_LITERAL_MAX + 1; sym < k; ++sym)
+        if (!xg_grammar_is_terminal_sym(g, sym) && sym != g->start)
+            ++n;
+
+    return n;
+}
+
+/* Output the visit counters of an instrumented parser with NSTATES
+   states and NCASES switch cases.  If ACTIONS is non-zero, the parser
+   is table driven and counts the actions of each state on each
+   terminal.  */
+void
+xg_gen_c_counters(FILE *out,
+                  const xg_grammar *g,
+                  unsigned int nstates,
+                  unsigned int ncases,
+                  int actions) {
+    fputs("/* Visit counters.  */\n", out);
+    fprintf(out, "static unsigned long xg__count_state[%u];\n", nstates);
+    fprintf(out, "static unsigned long xg__count_prod[%u];\n", xg_grammar_prod_count(g));
+    fprintf(out, "static unsigned long xg__count_symbol[%u];\n", nonterminal_count(g));
+    if (ncases != 0)
+        fprintf(out, "static unsigned long xg__count_case[%u];\n", ncases);
+    if (actions)
+        fprintf(out,
+                "static unsigned long xg__count_action[%u];\n",
+                nstates * (g->nterms + 1));
+    fputs("static unsigned long xg__count_depth[XG__DEPTH_BUCKETS];\n\n", out);
+}
+
+/* Output the N numbers at V as the array NAME of the type TYPE.  */
+static void
+emit_numbers(FILE *out,
+             const char *type,
+             const char *name,
+             const int *v,
+             unsigned int n) {
+    unsigned int i;
+
+    fprintf(out, "static const %s %s [] =\n{", type, name);
+    for (i = 0; i < n; ++i)
+        fprintf(out, "%s%d%s", i % 12 == 0 ? "\n  " : " ", v[i], i + 1 < n ? "," : "");
+    fputs("\n};\n\n", out);
+}
+
+/* Output the function, which writes the profile of an instrumented
+   parser.  The NCASES switch cases are in the states CASE_STATE and
+   are taken on the tokens CASE_TOKEN, or by default if the token is
+   negative.  If ACTIONS is non-zero, the parser is table driven and
+   counts the actions of each state on each terminal.  */
+void
+xg_gen_c_dump_profile(FILE *out,
+                      const xg_grammar *g,
+                      unsigned int nstates,
+                      unsigned int ncases,
+                      const unsigned int *case_state,
+                      const int *case_token,
+                      int actions) {
+    unsigned int i;
+    xg_sym sym, k;
+
+    /* Emit the symbol codes of the non-terminals.  */
+    fputs("static const unsigned int xg__count_nt_symbol [] =\n{", out);
+    k = xg_grammar_symbol_count(g);
+    for (i = 0, sym = XG_TOKEN_LITERAL_MAX + 1; sym < k; ++sym)
+        if (!xg_grammar_is_terminal_sym(g, sym) && sym != g->start)
+            fprintf(out, "%s%u,", i++ % 12 == 0 ? "\n  " : " ", sym);
+    fputs("\n};\n\n", out);
+
+    /* Emit the states and the tokens of the cases.  */
+    if (ncases != 0) {
+        xg_gen_c_array(out, "unsigned int", "xg__count_case_state", case_state, ncases);
+        emit_numbers(out, "int", "xg__count_case_token", case_token, ncases);
+    }
+
+    /* Emit the tokens of the terminals.  */
+    if (actions) {
+        fputs("static const int xg__count_term_token [] =\n{", out);
+        for (i = 0; i < g->nterms; ++i)
+            fprintf(out, "%s%u,", i % 12 == 0 ? "\n  " : " ", g->terms[i]);
+        fputs("\n};\n\n", out);
+    }
+
+    fprintf(out,
+            "int\n"
+            "xg_parse_dump_profile (const char *name)\n"
+            "{\n"
+            "  static const xg__counters cnt =\n"
+            "    {\n"
+            "      %u, xg__count_state,\n"
+            "      %u, xg__count_prod,\n"
+            "      %u, xg__count_nt_symbol, xg__count_symbol,\n",
+            nstates,
+            xg_grammar_prod_count(g),
+            nonterminal_count(g));
+    if (ncases != 0)
+        fprintf(out,
+                "      %u, xg__count_case_state, xg__count_case_token, xg__count_case,\n",
+                ncases);
+    else
+        fputs("      0, 0, 0, 0,\n", out);
+    if (actions)
+        fprintf(out, "      %u, xg__count_term_token, xg__count_action,\n", g->nterms);
+    else
+        fputs("      0, 0, 0,\n", out);
+    fputs(
+        "      xg__count_depth\n"
+        "    };\n\n"
+        "  return xg__write_profile (name, &cnt);\n"
+        "}\n",
+        out);
+}
+
+/* Switch cases of an instrumented parser: the state and the token of
+   each counted case, negative for the default one.  */
+struct cases {
+    unsigned int n;
+    unsigned int *state;
+    int *token;
+};
+
+/* Get an upper bound of the number of switch cases in the states of
+   the parser, which have code.  */
+static unsigned int
+case_bound(const xg_grammar *g, const xg_lr0dfa *dfa, const unsigned char *hot) {
+    unsigned int i, j, n, m, bound;
+    const xg_lr0state *state;
+    const xg_lr0trans *tr;
+
+    bound = 0;
+    n = xg_lr0dfa_state_count(dfa);
+    for (i = 0; i < n; ++i) {
+        if (hot && !hot[i])
+            continue;
+
+        state = xg_lr0dfa_get_state(dfa, i);
+        m = xg_lr0state_trans_count(state);
+        for (j = 0; j < m; ++j) {
+            tr = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(state, j));
+            if (xg_grammar_is_terminal_sym(g, tr->sym))
+                ++bound;
+        }
+
+        m = xg_lr0state_reduct_count(state);
+        if (m > 1)
+            for (j = 0; j < m; ++j)
+                bound += xg_lr0state_get_reduct(state, j)->la->count;
+
+        /* The default case.  */
+        ++bound;
+    }
+
+    return bound;
+}
+
+/* Emit the counter of the switch case of the state STATE on the token
+   TOKEN, or of the default case if TOKEN is negative, and record the
+   case in CS.  Do nothing, unless the parser is instrumented.  */
+static void
+count_case(FILE *out, struct cases *cs, unsigned int state, int token) {
+    if (cs == 0)
+        return;
+
+    cs->state[cs->n] = state;
+    cs->token[cs->n] = token;
+    fprintf(out, "      XG__COUNT (xg__count_case[%u]);\n", cs->n++);
+}
+
+/* Emit the interpreter of the cold states of a hybrid parser.  It
+   enters the state NEXT, either after shifting the token (at
+   COLD_SHIFT) or after a reduction (at COLD_PUSH), and performs the
+   parse actions from the tables, until it gets to a hot state.  If
+   ACTION is non-zero, some hot states leave their rare actions to the
+   interpreter (at COLD_ACTION).  */
+static void
+emit_cold_states(FILE *out,
+                 const xg_grammar *g,
+                 const xg_lr0dfa *dfa,
+                 const unsigned char *hot,
+                 int action,
+                 int instrument) {
+    unsigned int i, n;
+    const xg_lr0state *state;
+    int term;
+
+    fputs(
+        "cold_shift:\n"
+        "  XG__SHIFT;\n",
+        out);
+    if (instrument)
+        fputs("  XG__SAMPLE_DEPTH ();\n", out);
+    fputs(
+        "cold_push:\n"
+        "  XG__PUSH (next);\n",
+        out);
+    if (instrument)
+        fputs("  XG__COUNT (xg__count_state[next]);\n", out);
+    if (action)
+        fputs("cold_action:\n", out);
+    fputs(
+        "  act = XG__ACTION (state, XG__TERM (token));\n"
+        "  if (act > XG__ACCEPT && act < XG__ERROR)\n"
+        "    {\n"
+        "      act -= XG__NSTATES;\n"
+        "      XG__REDUCE (act, xg__prod_length[act]);\n",
+        out);
+    if (instrument)
+        fputs(
+            "      XG__COUNT (xg__count_prod[act]);\n"
+            "      XG__COUNT (xg__count_symbol[xg__prod_lhs[act]]);\n",
+            out);
+    fputs(
+        "      next = XG__GOTO (state, xg__prod_lhs[act]);\n"
+        "      goto resume_push;\n"
+        "    }\n"
+        "  if (act == XG__ACCEPT)\n"
+        "    goto accept;\n"
+        "  if (act == XG__ERROR)\n"
+        "    goto parse_error;\n\n"
+        "  switch (act)\n"
+        "    {\n",
+        out);
+
+    /* Shift to a hot state continues in its code.  */
+    n = xg_lr0dfa_state_count(dfa);
+    for (i = 0; i < n; ++i) {
+        state = xg_lr0dfa_get_state(dfa, i);
+        term = state->acc != XG_EPSILON && xg_grammar_is_terminal_sym(g, state->acc);
+        if (hot[i] && term)
+            fprintf(out,
+                    "    case %u:\n"
+                    "      goto shift_%u;\n",
+                    i,
+                    i);
+    }
+    fputs(
+        "    default:\n"
+        "      next = act;\n"
+        "      goto cold_shift;\n"
+        "    }\n\n",
+        out);
+
+    /* So does a transition on a non-terminal.  */
+    fputs(
+        "resume_push:\n"
+        "  if (xg__stack_ensure (&stk) < 0)\n"
+        "    goto internal_error;\n"
+        "  switch (next)\n"
+        "    {\n",
+        out);
+    for (i = 0; i < n; ++i) {
+        state = xg_lr0dfa_get_state(dfa, i);
+        term = state->acc != XG_EPSILON && xg_grammar_is_terminal_sym(g, state->acc);
+        if (hot[i] && state->acc != XG_EPSILON && !term)
+            fprintf(out,
+                    "    case %u:\n"
+                    "      goto push_%u;\n",
+                    i,
+                    i);
+    }
+    fputs(
+        "    default:\n"
+        "      goto cold_push;\n"
+        "    }\n\n",
+        out);
+}
+
+/* A case of a switch statement: the token or the state KEY and the
+   jump to the state or the production DST, together with the number
+   of times it was taken in the profile and its position in the
+   original order.  */
+struct branch {
+    unsigned int key;
+    enum { branch_shift, branch_cold_shift, branch_reduce, branch_push } kind;
+    unsigned int dst;
+    unsigned long count;
+    unsigned int index;
+};
+
+/* Add a case with the key KEY and the jump KIND to DST, taken COUNT
+   times, to the vector VEC.  Return negative on error.  */
+static int
+add_branch(ulib_vector *vec,
+           unsigned int key,
+           int kind,
+           unsigned int dst,
+           unsigned long count) {
+    struct branch br;
+
+    br.key = key;
+    br.kind = kind;
+    br.dst = dst;
+    br.count = count;
+    br.index = ulib_vector_length(vec);
+
+    return ulib_vector_append(vec, &br) < 0 ? -1 : 0;
+}
+
+/* Order cases by decreasing count, then by their original order.  */
+static int
+branch_cmp(const void *pa, const void *pb) {
+    const struct branch *a = pa, *b = pb;
+
+    if (a->count != b->count)
+        return a->count > b->count ? -1 : 1;
+    return a->index < b->index ? -1 : a->index > b->index;
+}
+
+/* Emit the jump of the case BR, indented by INDENT spaces.  */
+static void
+emit_jump(FILE *out, const struct branch *br, int indent) {
+    switch (br->kind) {
+    case branch_shift:
+        fprintf(out, "%*sgoto shift_%u;\n", indent, "", br->dst);
+        break;
+    case branch_cold_shift:
+        fprintf(out,
+                "%*snext = %u;\n"
+                "%*sgoto cold_shift;\n",
+                indent,
+                "",
+                br->dst,
+                indent,
+                "");
+        break;
+    case branch_reduce:
+        fprintf(out, "%*sgoto reduce_%u;\n", indent, "", br->dst);
+        break;
+    case branch_push:
+        fprintf(out, "%*sgoto push_%u;\n", indent, "", br->dst);
+        break;
+    }
+}
+
+/* Emit the case BR of the switch statement of the state STATE.  */
+static void
+emit_case(FILE *out, struct cases *cs, unsigned int state, const struct branch *br) {
+    fprintf(out, "    case %u:\n", br->key);
+    count_case(out, cs, state, br->key);
+    emit_jump(out, br, 6);
+}
+
+/* Emit a test for the case BR, which is taken most of the times, in
+   front of the switch statement of the state STATE.  */
+static void
+emit_likely_case(FILE *out,
+                 struct cases *cs,
+                 unsigned int state,
+                 const struct branch *br) {
+    fprintf(out, "  if (XG__LIKELY (token == %u))\n", br->key);
+    if (cs == 0 && br->kind != branch_cold_shift)
+        emit_jump(out, br, 4);
+    else {
+        fputs("    {\n", out);
+        count_case(out, cs, state, br->key);
+        emit_jump(out, br, 6);
+        fputs("    }\n", out);
+    }
+    fputs("\n", out);
+}
+
+/* Get the hot state, to which the state STATE most frequently shifts
+   in the profile PROF, or negative if there is none.  */
+static int
+hottest_shift(const xg_grammar *g,
+              const xg_lr0dfa *dfa,
+              const xg_profile *prof,
+              const unsigned char *hot,
+              unsigned int state) {
+    unsigned int j, m;
+    unsigned long cnt, best;
+    const xg_lr0state *st;
+    const xg_lr0trans *tr;
+    int dst;
+
+    st = xg_lr0dfa_get_state(dfa, state);
+    m = xg_lr0state_trans_count(st);
+    best = 0;
+    dst = -1;
+    for (j = 0; j < m; ++j) {
+        tr = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(st, j));
+        if (!xg_grammar_is_terminal_sym(g, tr->sym) || !hot[tr->dst])
+            continue;
+
+        cnt = xg_profile_case_count(prof, state, tr->sym);
+        if (cnt > best) {
+            best = cnt;
+            dst = tr->dst;
+        }
+    }
+
+    return dst;
+}
+
+/* Lay out the hot states of a profile guided parser into ORDER: the
+   hottest state first, followed by the chain of the destinations of
+   the most frequent shifts, then the hottest of the remaining states
+   and so on.  That way the most frequent shift out of a state falls
+   through to its destination.  Set *NORDER to the number of the states
+   in ORDER.  Return negative on error.  */
+static int
+layout_states(const xg_grammar *g,
+              const xg_lr0dfa *dfa,
+              const xg_profile *prof,
+              const unsigned char *hot,
+              unsigned int *order,
+              unsigned int *norder) {
+    unsigned int i, n, cnt, *byfreq;
+    unsigned char *placed;
+    int s;
+
+    n = xg_lr0dfa_state_count(dfa);
+    byfreq = 0;
+    if ((placed = xg_calloc(xg_mem_output, n, 1)) == 0
+        || (byfreq = xg_malloc(xg_mem_output, n * sizeof(unsigned int))) == 0
+        || xg_profile_order(prof->state, n, byfreq) < 0) {
+        xg_free(placed);
+        xg_free(byfreq);
+        return -1;
+    }
+
+    cnt = 0;
+    for (i = 0; i < n; ++i)
+        for (s = byfreq[i]; s >= 0 && hot[s] && !placed[s];
+             s = hottest_shift(g, dfa, prof, hot, s)) {
+            placed[s] = 1;
+            order[cnt++] = s;
+        }
+
+    xg_free(placed);
+    xg_free(byfreq);
+    *norder = cnt;
+    return 0;
+}
+
+/* Number the states, so that the sources of the transitions on the
+   same non-terminal get distinct numbers, as small as possible.
+   Return an array with the number of each state, which is zero for
+   the states without transitions on non-terminals, or null on
+   error.  */
+static unsigned int *
+number_predecessors(const xg_grammar *g, const xg_lr0dfa *dfa) {
+    unsigned int i, j, c, l, o, n, m, nsyms;
+    unsigned int *first, *pos, *pred, *predno, *taken, *order;
+    unsigned long *degree;
+    const xg_lr0state *state;
+    const xg_lr0trans *tr;
+
+    n = xg_lr0dfa_state_count(dfa);
+    m = xg_lr0dfa_trans_count(dfa);
+    nsyms = xg_grammar_symbol_count(g);
+    pos = pred = predno = taken = order = 0;
+    degree = 0;
+    if ((first = xg_calloc(xg_mem_output, nsyms + 1, sizeof(unsigned int))) == 0
+        || (pos = xg_malloc(xg_mem_output, nsyms * sizeof(unsigned int))) == 0
+        || (pred = xg_malloc(xg_mem_output, (m + 1) * sizeof(unsigned int))) == 0
+        || (predno = xg_malloc(xg_mem_output, n * sizeof(unsigned int))) == 0
+        || (taken = xg_malloc(xg_mem_output, n * sizeof(unsigned int))) == 0
+        || (order = xg_malloc(xg_mem_output, n * sizeof(unsigned int))) == 0
+        || (degree = xg_calloc(xg_mem_output, n, sizeof(unsigned long))) == 0)
+        goto error;
+
+    /* Bucket the sources of the transitions by the non-terminal.  */
+    for (j = 0; j < m; ++j) {
+        tr = xg_lr0dfa_get_trans(dfa, j);
+        if (!xg_grammar_is_terminal_sym(g, tr->sym))
+            ++first[tr->sym + 1];
+    }
+    for (i = 0; i < nsyms; ++i) {
+        first[i + 1] += first[i];
+        pos[i] = first[i];
+    }
+    for (j = 0; j < m; ++j) {
+        tr = xg_lr0dfa_get_trans(dfa, j);
+        if (!xg_grammar_is_terminal_sym(g, tr->sym))
+            pred[pos[tr->sym]++] = tr->src;
+    }
+
+    /* Number first the states, which share non-terminals with the most
+       other states.  That keeps the numbers of the sources of each
+       non-terminal close to dense.  */
+    for (j = 0; j < m; ++j) {
+        tr = xg_lr0dfa_get_trans(dfa, j);
+        if (!xg_grammar_is_terminal_sym(g, tr->sym))
+            degree[tr->src] += first[tr->sym + 1] - first[tr->sym];
+    }
+    if (xg_profile_order(degree, n, order) < 0)
+        goto error;
+
+    /* Give each state the smallest number, not taken by an already
+       numbered source of a transition on the same non-terminal.  The
+       number N is taken for the state I if TAKEN[N] is I.  */
+    for (i = 0; i < n; ++i) {
+        predno[i] = n;
+        taken[i] = n;
+    }
+    for (o = 0; o < n; ++o) {
+        i = order[o];
+        state = xg_lr0dfa_get_state(dfa, i);
+        m = xg_lr0state_trans_count(state);
+        for (j = 0; j < m; ++j) {
+            tr = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(state, j));
+            if (xg_grammar_is_terminal_sym(g, tr->sym))
+                continue;
+            for (l = first[tr->sym]; l < first[tr->sym + 1]; ++l)
+                if (predno[pred[l]] != n)
+                    taken[predno[pred[l]]] = i;
+        }
+
+        for (c = 0; taken[c] == i; ++c)
+            ;
+        predno[i] = c;
+    }
+
+    xg_free(first);
+    xg_free(pos);
+    xg_free(pred);
+    xg_free(taken);
+    xg_free(order);
+    xg_free(degree);
+    return predno;
+
+error:
+    xg_free(first);
+    xg_free(pos);
+    xg_free(pred);
+    xg_free(predno);
+    xg_free(taken);
+    xg_free(order);
+    xg_free(degree);
+    return 0;
+}
+
+/* Fill in the slot of each source of a transition on the
+   non-terminal SYM, indexed by its number in PREDNO, with the
+   destination state or negative, if the destination is to be looked
+   up in a hybrid parser with the hot states HOT, or if there is no
+   such source.  Return the number of the slots.  */
+static unsigned int
+fill_slots(const xg_lr0dfa *dfa,
+           xg_sym sym,
+           const unsigned int *predno,
+           const unsigned char *hot,
+           int *slot) {
+    unsigned int j, m, size;
+    const xg_lr0trans *tr;
+
+    size = 0;
+    m = xg_lr0dfa_trans_count(dfa);
+    for (j = 0; j < m; ++j) {
+        tr = xg_lr0dfa_get_trans(dfa, j);
+        if (tr->sym == sym && predno[tr->src] >= size)
+            size = predno[tr->src] + 1;
+    }
+    for (j = 0; j < size; ++j)
+        slot[j] = -1;
+    for (j = 0; j < m; ++j) {
+        tr = xg_lr0dfa_get_trans(dfa, j);
+        if (tr->sym == sym)
+            slot[predno[tr->src]]
+                = (hot && !(hot[tr->src] && hot[tr->dst]) ? -1 : (int)tr->dst);
+    }
+    return size;
+}
+
+/* Return the destination state, if all SIZE slots hold the same one,
+   or else negative.  A single destination needs no table.  */
+static int
+single_slot(const int *slot, unsigned int size) {
+    unsigned int j;
+
+    for (j = 1; j < size && slot[j] == slot[0]; ++j)
+        ;
+    return j == size ? slot[0] : -1;
+}
+
+/* Emit the jump to the destination of the transition on the
+   non-terminal SYM through a table of label addresses, indexed by the
+   number PREDNO of the state on the top of the stack, followed by the
+   start of the portable code.  In a hybrid parser, the transitions,
+   which do not connect hot states, are looked up in the parse tables
+   for the non-terminal number NT.  SLOT is an array for one entry per
+   state.  */
+static void
+emit_computed_goto(FILE *out,
+                   const xg_lr0dfa *dfa,
+                   xg_sym sym,
+                   const unsigned int *predno,
+                   const unsigned char *hot,
+                   unsigned int nt,
+                   int *slot) {
+    unsigned int j, size;
+    int lookup;
+
+    size = fill_slots(dfa, sym, predno, hot, slot);
+    if (single_slot(slot, size) >= 0) {
+        fprintf(out,
+                "#ifdef XG__COMPUTED_GOTO\n"
+                "  goto push_%d;\n"
+                "#else\n",
+                slot[0]);
+        return;
+    }
+
+    fputs(
+        "#ifdef XG__COMPUTED_GOTO\n"
+        "  {\n"
+        "    static const void *const xg__dst [] =\n"
+        "      {",
+        out);
+    lookup = 0;
+    for (j = 0; j < size; ++j) {
+        fputs(j % 4 == 0 ? "\n        " : " ", out);
+        if (slot[j] >= 0)
+            fprintf(out, "&&push_%d", slot[j]);
+        else if (hot) {
+            fprintf(out, "&&lookup_%u", sym);
+            lookup = 1;
+        } else
+            fputs("&&internal_error", out);
+        fputs(j + 1 < size ? "," : "", out);
+    }
+    fputs(
+        "\n"
+        "      };\n\n"
+        "    goto *xg__dst[xg__pred[state]];\n"
+        "  }\n",
+        out);
+    if (lookup)
+        fprintf(out,
+                "lookup_%u:\n"
+                "  next = XG__GOTO (state, %u);\n"
+                "  goto resume_push;\n",
+                sym,
+                nt);
+    fputs("#else\n", out);
+}
+
+int
+xg_gen_c_parser(FILE *out,
+                const xg_grammar *g,
+                const xg_lr0dfa *dfa,
+                const xg_gen_c_options *opt) {
+    xg_sym sym;
+    unsigned int i, j, k, n, m, t, o, pos, dst, nnts, bound, norder, first, nbr;
+    unsigned long ncases = 0, total, cnt;
+    const xg_lr0state *state;
+    const xg_lr0trans *tr;
+    const xg_lr0reduct *rd;
+    const xg_prod *p;
+    const xg_profile *prof = opt->prof;
+    ulib_vector casevec, brvec;
+    struct branch *br;
+    unsigned char *hot, *used;
+    unsigned int *ntno, *order, *predno;
+    unsigned long *weight;
+    int *slot;
+    struct cases counted, *cs;
+    int cold, deferred, tables, sts = -1;
+
+    (void)ulib_vector_init(&casevec, ULIB_ELT_SIZE, sizeof(struct freq), 0);
+    (void)ulib_vector_init(&brvec, ULIB_ELT_SIZE, sizeof(struct branch), 0);
+    hot = used = 0;
+    ntno = order = predno = 0;
+    weight = 0;
+    slot = 0;
+    memset(&counted, 0, sizeof(counted));
+    cs = 0;
+    bound = 0;
+    deferred = 0;
+
+    /* The states, the productions and the non-terminals are output in
+       the order of their numbers, unless a profile says otherwise.  */
+    n = xg_lr0dfa_state_count(dfa);
+    k = xg_grammar_symbol_count(g);
+    m = xg_grammar_prod_count(g);
+    if ((order = xg_malloc(xg_mem_output, (n > k + m ? n : k + m) * sizeof(unsigned int)))
+        == 0)
+        goto error;
+
+    /* A hybrid parser needs the hot states, the productions, reduced in
+       them, the non-terminals, which are their left hand sides, and the
+       parse tables for the remaining states.  It lays the hot states out
+       according to the profile.  */
+    if (prof) {
+        if ((hot = xg_malloc(xg_mem_output, n)) == 0
+            || (used = xg_calloc(xg_mem_output, m + k, 1)) == 0
+            || (weight = xg_calloc(xg_mem_output, k, sizeof(unsigned long))) == 0
+            || xg_profile_hot_states(prof, opt->coverage, hot) < 0
+            || layout_states(g, dfa, prof, hot, order, &norder) < 0)
+            goto error;
+
+        /* Mark the productions, reduced in the hot states, and their
+           left hand sides.  */
+        for (o = 0; o < norder; ++o) {
+            state = xg_lr0dfa_get_state(dfa, order[o]);
+            for (j = 0; j < xg_lr0state_reduct_count(state); ++j)
+                used[xg_lr0state_get_reduct(state, j)->prod] = 1;
+        }
+        for (i = 1; i < m; ++i)
+            if (used[i])
+                used[m + xg_grammar_get_prod(g, i)->lhs] = 1;
+    } else {
+        for (i = 0; i < n; ++i)
+            order[i] = i;
+        norder = n;
+    }
+
+    /* Both the hybrid and the instrumented parsers count non-terminals,
+       the latter also record the cases they count.  */
+    if ((prof || opt->instrument) && (ntno = xg_gen_c_nonterminals(g, &nnts)) == 0)
+        goto error;
+
+    if (opt->computed_goto
+        && ((predno = number_predecessors(g, dfa)) == 0
+            || (slot = xg_malloc(xg_mem_output, n * sizeof(int))) == 0))
+        goto error;
+
+    /* The numbers of the states are needed only if some of the
+       emitted non-terminals has more than one destination.  Without
+       any, a hybrid parser still jumps directly to the single
+       destinations, while the other parser is the same as without
+       computed goto.  */
+    tables = 0;
+    for (sym = XG_TOKEN_LITERAL_MAX + 1; predno && !tables && sym < (xg_sym)k; ++sym)
+        if (!xg_grammar_is_terminal_sym(g, sym) && sym != g->start
+            && !(used && !used[m + sym]))
+            tables = single_slot(slot, fill_slots(dfa, sym, predno, hot, slot)) < 0;
+    if (predno && !tables && !hot) {
+        xg_free(predno);
+        xg_free(slot);
+        predno = 0;
+        slot = 0;
+    }
+
+    if (opt->instrument) {
+        bound = case_bound(g, dfa, hot);
+        if ((counted.state = xg_malloc(xg_mem_output, bound * sizeof(unsigned int))) == 0
+            || (counted.token = xg_malloc(xg_mem_output, bound * sizeof(int))) == 0)
+            goto error;
+        cs = &counted;
+
+        fputs("#define XG__INSTRUMENT 1\n", out);
+    }
+
+    /* Include the common parser declarations.  */
+    fputs("#include <xg-c-parser.h>\n\n", out);
+
+    /* Emit symbol names and productions.  */
+    xg_gen_c_debug_names(out, g);
+
+    if (prof && xg_gen_c_parse_tables(out, g, dfa) < 0)
+        goto error;
+
+    if (opt->instrument)
+        xg_gen_c_counters(out, g, n, bound, 0);
+
+    if (tables) {
+        fputs(
+            "#ifdef XG__COMPUTED_GOTO\n"
+            "/* Numbers of the states in the tables of the destinations of\n"
+            "   the transitions on non-terminals.  */\n",
+            out);
+        xg_gen_c_array(out, 0, "xg__pred", predno, n);
+        fputs("#endif /* XG__COMPUTED_GOTO */\n\n", out);
+    }
 
     /* Emit parser function preambule.  */
     fputs(
         "int\n"
         "xg_parse (xg_parse_ctx *ctx)\n"
-        "{\n"
-        "  XG__PARSER_FUNCTION_START;\n\n",
+        "{\n",
         out);
+    if (prof)
+        fputs(
+            "  /* State to enter and parse action in the cold states.  */\n"
+            "  unsigned int next, act;\n\n",
+            out);
+    fputs("  XG__PARSER_FUNCTION_START;\n\n", out);
+
+    /* Emit parse actions for each state.  Cold states have no code.  */
+    for (o = 0; o < norder; ++o) {
+        i = order[o];
 
-    /* Emit parse actions for each state.  */
-    n = xg_lr0dfa_state_count(dfa);
-    for (i = 0; i < n; ++i) {
         /* Emit stack manipulation.  */
         state = xg_lr0dfa_get_state(dfa, i);
 
@@ -147,183 +927,328 @@ xg_gen_c_parser(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa) {
                     "shift_%u:\n"
                     "  XG__SHIFT;\n",
                     i);
+            if (opt->instrument)
+                fputs("  XG__SAMPLE_DEPTH ();\n", out);
         } else
             /* States, accessible only by non-terminal symbols need a
            label to jump to.  */
             fprintf(out, "push_%u:\n", i);
 
-        fprintf(out, "  XG__PUSH (%u);\n\n", i);
+        fprintf(out, "  XG__PUSH (%u);\n", i);
+        if (opt->instrument)
+            fprintf(out, "  XG__COUNT (xg__count_state[%u]);\n", i);
+        fputs("\n", out);
 
-        /* There's a single switch statement for shift and reduce
-         actions.  */
-        fputs(
-            "  switch (token)\n"
-            "    {\n",
-            out);
+        /* In a hybrid parser, the shifts to cold states in a state
+           without reductions are left to the interpreter, together with
+           the errors.  */
+        cold = (hot && xg_lr0state_reduct_count(state) == 0 && !state->accept);
 
-        /* Emit shift actions.  */
+        /* Collect shift actions.  */
+        ulib_vector_set_size(&brvec, 0);
         m = xg_lr0state_trans_count(state);
         for (j = 0; j < m; ++j) {
             tr = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(state, j));
-            if (xg_grammar_is_terminal_sym(g, tr->sym))
-                fprintf(out,
-                        "    case %u:\n"
-                        "      goto shift_%u;\n",
-                        tr->sym,
-                        tr->dst);
+            if (!xg_grammar_is_terminal_sym(g, tr->sym) || (hot && !hot[tr->dst] && cold))
+                continue;
+
+            if (add_branch(&brvec,
+                           tr->sym,
+                           hot && !hot[tr->dst] ? branch_cold_shift : branch_shift,
+                           tr->dst,
+                           prof ? xg_profile_case_count(prof, i, tr->sym) : 0)
+                < 0)
+                goto error;
         }
 
-        /* Emit reduce actions.  */
+        /* Collect reduce actions.  */
         m = xg_lr0state_reduct_count(state);
-
+        dst = 0;
         if (m > 1) {
-            /* Compute the frequency of each reduction.  */
+            /* Compute the frequency of each reduction: the number of
+               times it was taken in the profile or else the number of
+               its lookaheads.  */
             ulib_vector_set_size(&casevec, 0);
-            for (j = 0; j < m; ++j) {
+            total = 0;
+            for (j = 0; prof && j < m; ++j) {
                 rd = xg_lr0state_get_reduct(state, j);
 
-                k = ulib_bitset_max(&rd->la);
-                for (sym = 0; sym < k; ++sym)
-                    if (ulib_bitset_is_set(&rd->la, sym)) {
-                        if (increment_freq(&casevec, rd->prod) < 0)
-                            goto error;
-                    }
+                pos = 0;
+                cnt = 0;
+                while ((t = xg_laset_next(rd->la, &pos)) != XG_LASET_END)
+                    cnt += xg_profile_case_count(prof, i, g->terms[t]);
+                if (add_freq(&casevec, rd->prod, cnt) < 0)
+                    goto error;
+                total += cnt;
             }
 
-            /* Emit reduction cases.  */
+            if (total == 0) {
+                ulib_vector_set_size(&casevec, 0);
+                for (j = 0; j < m; ++j) {
+                    rd = xg_lr0state_get_reduct(state, j);
+
+                    if (add_freq(&casevec, rd->prod, rd->la->count) < 0)
+                        goto error;
+                }
+            }
             dst = max_freq(&casevec);
-            fprintf(out,
-                    "    default:\n"
-                    "      goto reduce_%u;\n",
-                    dst);
 
+            /* The lookaheads of the most frequent reduction are left to
+               the default case, except in an instrumented parser, which
+               counts each of them.  */
             for (j = 0; j < m; ++j) {
                 rd = xg_lr0state_get_reduct(state, j);
 
-                if (rd->prod == dst)
+                if (rd->prod == dst && cs == 0)
                     continue;
 
-                k = ulib_bitset_max(&rd->la);
-                for (sym = 0; sym < k; ++sym)
-                    if (ulib_bitset_is_set(&rd->la, sym))
-                        fprintf(out,
-                                "    case %u:\n"
-                                "      goto reduce_%u;\n",
-                                sym,
-                                rd->prod);
+                pos = 0;
+                while ((t = xg_laset_next(rd->la, &pos)) != XG_LASET_END)
+                    if (add_branch(&brvec,
+                                   g->terms[t],
+                                   branch_reduce,
+                                   rd->prod,
+                                   prof ? xg_profile_case_count(prof, i, g->terms[t]) : 0)
+                        < 0)
+                        goto error;
             }
+        }
+
+        /* With a profile, the cases are ordered by frequency and the
+           one, taken most of the times, is tested first.  */
+        br = ulib_vector_front(&brvec);
+        nbr = ulib_vector_length(&brvec);
+        first = 0;
+        if (prof && nbr != 0) {
+            qsort(br, nbr, sizeof(struct branch), branch_cmp);
+            if (br[0].count > prof->state[i] / 2) {
+                emit_likely_case(out, cs, i, &br[0]);
+                first = 1;
+            }
+        }
+
+        /* There's a single switch statement for shift and reduce
+         actions.  */
+        fputs(
+            "  switch (token)\n"
+            "    {\n",
+            out);
+
+        /* Emit the cases, without a profile only the shifts first.  */
+        for (j = first; j < nbr; ++j)
+            if (prof || br[j].kind != branch_reduce)
+                emit_case(out, cs, i, &br[j]);
+        ncases += nbr;
+
+        if (m > 1) {
+            /* Emit reduction cases.  */
+            fputs("    default:\n", out);
+            count_case(out, cs, i, -1);
+            fprintf(out, "      goto reduce_%u;\n", dst);
+
+            for (j = first; !prof && j < nbr; ++j)
+                if (br[j].kind == branch_reduce)
+                    emit_case(out, cs, i, &br[j]);
         } else if (m == 1) {
             /* If there's only one reduction, jump straight to the
              reduction code, without checking lookaheads.  The
              eventual error will be detected later, when we have to
              shift the errorneous token.  */
             rd = xg_lr0state_get_reduct(state, 0);
-            fprintf(out,
-                    "    default:\n"
-                    "      goto reduce_%u;\n",
-                    rd->prod);
+            fputs("    default:\n", out);
+            count_case(out, cs, i, -1);
+            fprintf(out, "      goto reduce_%u;\n", rd->prod);
         } else /* m == 0 */
         {
             /* If there are no reductions, jump to the parse error
              handling code, unless this is the accepting state.  */
+            fputs("    default:\n", out);
+            count_case(out, cs, i, -1);
             if (state->accept)
-                fputs(
-                    "    default:\n"
-                    "      goto accept;\n",
-                    out);
-            else
-                fputs(
-                    "    default:\n"
-                    "      goto parse_error;\n",
-                    out);
+                fputs("      goto accept;\n", out);
+            else if (cold) {
+                fputs("      goto cold_action;\n", out);
+                deferred = 1;
+            } else
+                fputs("      goto parse_error;\n", out);
         }
 
         fputs("    }\n\n\n", out);
     }
 
-    /* Emit reduce actions for each production. Skip "reduce" by
-     production 0 as this constitutes an accept and is handled
-     elsewhere.  */
+    /* Emit reduce actions for each production, the most frequent ones
+       first. Skip "reduce" by production 0 as this constitutes an
+       accept and is handled elsewhere.  */
     n = xg_grammar_prod_count(g);
-    for (i = 1; i < n; ++i) {
+    if (prof) {
+        if (xg_profile_order(prof->prod, n, order) < 0)
+            goto error;
+    } else
+        for (i = 0; i < n; ++i)
+            order[i] = i;
+
+    for (o = 0; o < n; ++o) {
+        i = order[o];
+        if (i == 0 || (used && !used[i]))
+            continue;
+
         p = xg_grammar_get_prod(g, i);
+        if (weight)
+            weight[p->lhs] += prof->prod[i];
         fprintf(out,
                 "reduce_%u:\n"
-                "  XG__REDUCE (%u, %u);\n"
-                "  goto symbol_%u;\n\n",
+                "  XG__REDUCE (%u, %u);\n",
                 i,
                 i,
-                xg_prod_length(p),
-                p->lhs);
+                xg_prod_length(p));
+        if (opt->instrument)
+            fprintf(out, "  XG__COUNT (xg__count_prod[%u]);\n", i);
+        fprintf(out, "  goto symbol_%u;\n\n", p->lhs);
     }
 
     /* Emit non-terminal transitions code.  For each non-terminal
      symbol, jump to the appropriate destination state, depending on
-     the current top of the stack state.  */
-    k = xg_grammar_symbol_count(g);
+     the current top of the stack state.  The symbols are ordered by
+     the number of reductions to them.  */
+    if (prof) {
+        if (xg_profile_order(weight, k, order) < 0)
+            goto error;
+    } else
+        for (i = 0; i < k; ++i)
+            order[i] = i;
+
     m = xg_lr0dfa_trans_count(dfa);
-    for (sym = XG_TOKEN_LITERAL_MAX + 1; sym < k; ++sym) {
-        if (xg_grammar_is_terminal_sym(g, sym) || sym == g->start)
+    for (o = 0; o < k; ++o) {
+        sym = order[o];
+        if (sym <= XG_TOKEN_LITERAL_MAX || xg_grammar_is_terminal_sym(g, sym)
+            || sym == g->start)
+            continue;
+
+        if (used && !used[n + sym])
             continue;
 
         fprintf(out, "symbol_%u:\n", sym);
+        if (opt->instrument)
+            fprintf(out, "  XG__COUNT (xg__count_symbol[%u]);\n", ntno[sym]);
+        if (predno)
+            emit_computed_goto(out, dfa, sym, predno, hot, ntno ? ntno[sym] : 0, slot);
         fputs(
             "  switch (state)\n"
             "    {\n",
             out);
 
-        /* Compute transition frequencies.  */
-        ulib_vector_set_size(&casevec, 0);
-        for (j = 0; j < m; ++j) {
-            tr = xg_lr0dfa_get_trans(dfa, j);
-            if (tr->sym == sym)
-                if (increment_freq(&casevec, tr->dst) < 0)
-                    goto error;
-        }
-
-        if (ulib_vector_length(&casevec) != 0) {
-            /* Emit transition cases.  */
-            dst = max_freq(&casevec);
+        if (hot) {
+            /* Jump directly only between hot states, the most frequent
+               destinations first, look up the others.  */
+            ulib_vector_set_size(&brvec, 0);
             for (j = 0; j < m; ++j) {
                 tr = xg_lr0dfa_get_trans(dfa, j);
-                if (tr->sym == sym) {
-                    if (tr->dst != dst)
-                        fprintf(out,
-                                "    case %u:\n"
-                                "      goto push_%u;\n",
-                                tr->src,
-                                tr->dst);
-                }
+                if (tr->sym == sym && hot[tr->src] && hot[tr->dst]
+                    && add_branch(
+                           &brvec, tr->src, branch_push, tr->dst, prof->state[tr->dst])
+                           < 0)
+                    goto error;
+            }
+
+            br = ulib_vector_front(&brvec);
+            nbr = ulib_vector_length(&brvec);
+            if (nbr != 0)
+                qsort(br, nbr, sizeof(struct branch), branch_cmp);
+            for (j = 0; j < nbr; ++j) {
+                fprintf(out, "    case %u:\n", br[j].key);
+                emit_jump(out, &br[j], 6);
             }
+            ncases += nbr;
 
             fprintf(out,
                     "    default:\n"
-                    "      goto push_%u;\n",
-                    dst);
+                    "      next = XG__GOTO (state, %u);\n"
+                    "      goto resume_push;\n",
+                    ntno[sym]);
+        } else {
+            /* Compute transition frequencies.  */
+            ulib_vector_set_size(&casevec, 0);
+            for (j = 0; j < m; ++j) {
+                tr = xg_lr0dfa_get_trans(dfa, j);
+                if (tr->sym == sym)
+                    if (add_freq(&casevec, tr->dst, 1) < 0)
+                        goto error;
+            }
+
+            if (ulib_vector_length(&casevec) != 0) {
+                /* Emit transition cases.  */
+                dst = max_freq(&casevec);
+                for (j = 0; j < m; ++j) {
+                    tr = xg_lr0dfa_get_trans(dfa, j);
+                    if (tr->sym == sym) {
+                        if (tr->dst != dst) {
+                            fprintf(out,
+                                    "    case %u:\n"
+                                    "      goto push_%u;\n",
+                                    tr->src,
+                                    tr->dst);
+                            ++ncases;
+                        }
+                    }
+                }
+
+                fprintf(out,
+                        "    default:\n"
+                        "      goto push_%u;\n",
+                        dst);
+            }
         }
-        fputs("    }\n\n", out);
+        fputs("    }\n", out);
+        if (predno)
+            fputs("#endif /* XG__COMPUTED_GOTO */\n", out);
+        fputs("\n", out);
     }
 
-    fputs(
-        "internal_error:\n"
-        "  XG__PARSER_FUNCTION_END (-1);\n\n",
-        out);
-    fputs(
-        "parse_error:\n"
-        "  XG__PARSER_FUNCTION_END (-1);\n\n",
-        out);
+    if (hot)
+        emit_cold_states(out, g, dfa, hot, deferred, opt->instrument);
+
+    /* With a profile, the error handling code is known to be cold.  */
+    fprintf(out,
+            "internal_error:%s\n"
+            "  XG__PARSER_FUNCTION_END (-1);\n\n",
+            prof ? " XG__COLD;" : "");
+    fprintf(out,
+            "parse_error:%s\n"
+            "  XG__PARSER_FUNCTION_END (-1);\n\n",
+            prof ? " XG__COLD;" : "");
     fputs(
         "accept:\n"
         "  XG__PARSER_FUNCTION_END (0);\n",
         out);
     fputs("}\n", out);
 
-    ulib_vector_destroy(&casevec);
-    return 0;
+    if (opt->instrument) {
+        fputs("\n", out);
+        xg_gen_c_dump_profile(out,
+                              g,
+                              xg_lr0dfa_state_count(dfa),
+                              counted.n,
+                              counted.state,
+                              counted.token,
+                              0);
+    }
+
+    xg_stat_add(xg_stat_cases, ncases);
+    sts = 0;
 
 error:
     ulib_vector_destroy(&casevec);
-    return -1;
+    ulib_vector_destroy(&brvec);
+    xg_free(hot);
+    xg_free(used);
+    xg_free(ntno);
+    xg_free(order);
+    xg_free(weight);
+    xg_free(predno);
+    xg_free(slot);
+    xg_free(counted.state);
+    xg_free(counted.token);
+    return sts;
 }
 
 /*
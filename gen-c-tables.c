@@ -0,0 +1,674 @@
+/* gen-c-tables.c - generate a table driven parser in ISO C
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "grammar.h"
+#include "lr0.h"
+#include "gen-parser.h"
+#include "stats.h"
+#include "xg.h"
+#include <ulib/vector.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The parse tables consist of a row for each state, indexed by the
+   terminal number of the lookahead token, and a row for each
+   non-terminal, indexed by the state on the top of the stack.
+
+   The state rows contain the parse actions, encoded as follows: a
+   value S below the number of states NSTATES is a shift to the state
+   S, the value NSTATES + P is a reduction by the production P, with
+   the reduction by the production 0 meaning accept, and the value
+   NSTATES + NPRODS is an error.  The most frequent reduction of each
+   state, or the error, if it has none, becomes the default action of
+   the state and is not stored in the row.  The non-terminal rows
+   contain the destinations of the transitions, except the most
+   frequent one, which becomes the default.
+
+   All the rows are packed into a single comb vector.  A row is placed
+   at an offset BASE, such that its entries occupy free slots, and the
+   column of each entry is recorded in the CHECK vector.  Distinct rows
+   get distinct offsets, thus CHECK[BASE + C] == C only if the slot
+   belongs to the row.  Identical rows share their offset.  */
+
+/* An entry of a row.  */
+struct table_ent {
+    unsigned int col;
+    unsigned int val;
+};
+typedef struct table_ent table_ent;
+
+/* A row of the parse tables.  */
+struct table_row {
+    /* Row number: the states come first, followed by the
+       non-terminals.  */
+    unsigned int id;
+
+    /* Entries in ascending order of their columns.  */
+    unsigned int nent;
+    const table_ent *ent;
+};
+typedef struct table_row table_row;
+
+/* Parse tables under construction.  */
+struct tables {
+    /* Number of states, productions, terminals and non-terminals.  The
+       terminal number NTERMS stands for the tokens, which are not
+       terminals of the grammar.  */
+    unsigned int nstates;
+    unsigned int nprods;
+    unsigned int nterms;
+    unsigned int nnts;
+
+    /* Non-terminal number of each symbol.  */
+    unsigned int *ntno;
+
+    /* Entries of all the rows.  */
+    ulib_vector ent;
+
+    /* Rows, their first entries and their offsets.  */
+    table_row *row;
+    unsigned int *first;
+    unsigned int *base;
+
+    /* Default action of each state and default destination of each
+       non-terminal.  */
+    unsigned int *defact;
+    unsigned int *defgoto;
+
+    /* The comb vector: length, allocated size, columns and values.  */
+    unsigned int size;
+    unsigned int alloc;
+    unsigned int *check;
+    unsigned int *value;
+
+    /* Offsets in use.  */
+    unsigned char *used;
+};
+typedef struct tables tables;
+
+/* Column in the CHECK vector of the free slots.  */
+static unsigned int
+free_column(const tables *tb) {
+    return (tb->nterms + 1 > tb->nstates ? tb->nterms + 1 : tb->nstates);
+}
+
+/* Append the entry <COL, VAL> to the current row.  */
+static int
+add_entry(tables *tb, unsigned int col, unsigned int val) {
+    table_ent e = {col, val};
+
+    return ulib_vector_append(&tb->ent, &e) == 0 ? 0 : -1;
+}
+
+/* Create the rows of the states.  ACT is a scratch array of NTERMS
+   elements.  */
+static int
+make_action_rows(tables *tb,
+                 const xg_grammar *g,
+                 const xg_lr0dfa *dfa,
+                 unsigned int *act) {
+    unsigned int i, j, m, t, pos, dflt, none;
+    const xg_lr0state *state;
+    const xg_lr0trans *tr;
+    const xg_lr0reduct *rd, *max;
+
+    none = tb->nstates + tb->nprods;
+    for (t = 0; t < tb->nterms; ++t)
+        act[t] = none;
+
+    for (i = 0; i < tb->nstates; ++i) {
+        state = xg_lr0dfa_get_state(dfa, i);
+
+        /* Shift actions.  */
+        m = xg_lr0state_trans_count(state);
+        for (j = 0; j < m; ++j) {
+            tr = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(state, j));
+            if (xg_grammar_is_terminal_sym(g, tr->sym))
+                act[g->termno[tr->sym]] = tr->dst;
+        }
+
+        /* The reduction with the most lookaheads is the default,
+           without reductions the default is an accept or an error.  */
+        m = xg_lr0state_reduct_count(state);
+        max = 0;
+        for (j = 0; j < m; ++j) {
+            rd = xg_lr0state_get_reduct(state, j);
+            if (max == 0 || rd->la->count > max->la->count)
+                max = rd;
+        }
+
+        if (max)
+            dflt = tb->nstates + max->prod;
+        else if (state->accept)
+            dflt = tb->nstates;
+        else
+            dflt = none;
+        tb->defact[i] = dflt;
+
+        /* Other reductions.  */
+        for (j = 0; j < m; ++j) {
+            rd = xg_lr0state_get_reduct(state, j);
+            if (rd == max)
+                continue;
+
+            pos = 0;
+            while ((t = xg_laset_next(rd->la, &pos)) != XG_LASET_END)
+                act[t] = tb->nstates + rd->prod;
+        }
+
+        /* Store the non-default actions in the order of the terminal
+           numbers.  */
+        tb->first[i] = ulib_vector_length(&tb->ent);
+        for (t = 0; t < tb->nterms; ++t) {
+            if (act[t] != none && act[t] != dflt && add_entry(tb, t, act[t]) < 0)
+                return -1;
+            act[t] = none;
+        }
+    }
+
+    return 0;
+}
+
+/* Create the rows of the non-terminals.  COUNT is a scratch array of
+   NSTATES elements.  */
+static int
+make_goto_rows(tables *tb,
+               const xg_grammar *g,
+               const xg_lr0dfa *dfa,
+               unsigned int *count) {
+    unsigned int i, j, m, n, nt, dflt, *start;
+    table_ent *tr;
+    const xg_lr0state *state;
+    const xg_lr0trans *t;
+    int sts = -1;
+
+    if ((start = xg_calloc(xg_mem_output, tb->nnts + 1, sizeof(unsigned int))) == 0)
+        return -1;
+    tr = 0;
+
+    /* Bucket the non-terminal transitions by their symbol.  Walking the
+       states in order leaves each bucket sorted by source state.  */
+    for (n = 0; n < 2; ++n) {
+        for (i = 0; i < tb->nstates; ++i) {
+            state = xg_lr0dfa_get_state(dfa, i);
+            m = xg_lr0state_trans_count(state);
+            for (j = 0; j < m; ++j) {
+                t = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(state, j));
+                if (xg_grammar_is_terminal_sym(g, t->sym) || t->sym == g->start)
+                    continue;
+
+                nt = tb->ntno[t->sym];
+                if (n == 0)
+                    ++start[nt + 1];
+                else {
+                    tr[start[nt]].col = i;
+                    tr[start[nt]].val = t->dst;
+                    ++start[nt];
+                }
+            }
+        }
+
+        if (n == 0) {
+            for (nt = 0; nt < tb->nnts; ++nt)
+                start[nt + 1] += start[nt];
+            if ((tr = xg_malloc(xg_mem_output, (start[tb->nnts] + 1) * sizeof(*tr))) == 0)
+                goto error;
+        } else {
+            /* Filling the buckets moved each start to the next one.  */
+            memmove(start + 1, start, tb->nnts * sizeof(unsigned int));
+            start[0] = 0;
+        }
+    }
+
+    memset(count, 0, tb->nstates * sizeof(unsigned int));
+    for (nt = 0; nt < tb->nnts; ++nt) {
+        /* The most frequent destination is the default.  */
+        dflt = 0;
+        for (j = start[nt]; j < start[nt + 1]; ++j)
+            if (++count[tr[j].val] > count[dflt] || j == start[nt])
+                dflt = tr[j].val;
+        for (j = start[nt]; j < start[nt + 1]; ++j)
+            count[tr[j].val] = 0;
+        tb->defgoto[nt] = dflt;
+
+        tb->first[tb->nstates + nt] = ulib_vector_length(&tb->ent);
+        for (j = start[nt]; j < start[nt + 1]; ++j)
+            if (tr[j].val != dflt && add_entry(tb, tr[j].col, tr[j].val) < 0)
+                goto error;
+    }
+
+    sts = 0;
+error:
+    xg_free(tr);
+    xg_free(start);
+    return sts;
+}
+
+/* Order rows by decreasing number of entries, identical rows
+   adjacent.  */
+static int
+row_cmp(const void *pa, const void *pb) {
+    const table_row *a = pa, *b = pb;
+    unsigned int i;
+
+    if (a->nent != b->nent)
+        return a->nent > b->nent ? -1 : 1;
+
+    for (i = 0; i < a->nent; ++i) {
+        if (a->ent[i].col != b->ent[i].col)
+            return a->ent[i].col < b->ent[i].col ? -1 : 1;
+        if (a->ent[i].val != b->ent[i].val)
+            return a->ent[i].val < b->ent[i].val ? -1 : 1;
+    }
+
+    return a->id < b->id ? -1 : a->id > b->id;
+}
+
+/* Check whether the rows A and B have the same entries.  */
+static int
+same_row(const table_row *a, const table_row *b) {
+    return a->nent == b->nent && memcmp(a->ent, b->ent, a->nent * sizeof(table_ent)) == 0;
+}
+
+/* Make sure the comb vector has at least N slots.  */
+static int
+ensure_size(tables *tb, unsigned int n) {
+    unsigned int i, na, col;
+    void *p;
+
+    if (n <= tb->alloc)
+        return 0;
+
+    na = tb->alloc * 2 > n ? tb->alloc * 2 : n;
+    if ((p = xg_realloc(xg_mem_output, tb->check, na * sizeof(unsigned int))) == 0)
+        return -1;
+    tb->check = p;
+    if ((p = xg_realloc(xg_mem_output, tb->value, na * sizeof(unsigned int))) == 0)
+        return -1;
+    tb->value = p;
+    if ((p = xg_realloc(xg_mem_output, tb->used, na)) == 0)
+        return -1;
+    tb->used = p;
+
+    col = free_column(tb);
+    for (i = tb->alloc; i < na; ++i) {
+        tb->check[i] = col;
+        tb->value[i] = 0;
+        tb->used[i] = 0;
+    }
+    tb->alloc = na;
+
+    return 0;
+}
+
+/* Check whether the row R fits at the offset B.  */
+static int
+row_fits(const tables *tb, const table_row *r, unsigned int b) {
+    unsigned int i, col;
+
+    col = free_column(tb);
+    for (i = 0; i < r->nent; ++i)
+        if (tb->check[b + r->ent[i].col] != col)
+            return 0;
+
+    return 1;
+}
+
+/* Pack the rows into the comb vector.  */
+static int
+pack_rows(tables *tb) {
+    unsigned int i, j, n, b, lo, ncols;
+    const table_row *r, *prev;
+
+    n = tb->nstates + tb->nnts;
+    qsort(tb->row, n, sizeof(table_row), row_cmp);
+
+    lo = 0;
+    prev = 0;
+    for (i = 0; i < n && tb->row[i].nent != 0; ++i) {
+        r = &tb->row[i];
+        if (prev && same_row(prev, r)) {
+            tb->base[r->id] = tb->base[prev->id];
+            continue;
+        }
+
+        /* First fit, starting from the lowest free slot.  */
+        b = lo > r->ent[0].col ? lo - r->ent[0].col : 0;
+        for (;; ++b) {
+            if (ensure_size(tb, b + r->ent[r->nent - 1].col + 1) < 0)
+                return -1;
+            if (!tb->used[b] && row_fits(tb, r, b))
+                break;
+        }
+
+        for (j = 0; j < r->nent; ++j) {
+            tb->check[b + r->ent[j].col] = r->ent[j].col;
+            tb->value[b + r->ent[j].col] = r->ent[j].val;
+        }
+        tb->used[b] = 1;
+        tb->base[r->id] = b;
+        prev = r;
+
+        while (lo < tb->alloc && tb->check[lo] != free_column(tb))
+            ++lo;
+    }
+
+    /* The empty rows share an offset, which no other row uses.  */
+    for (b = 0; b < tb->alloc && tb->used[b]; ++b)
+        ;
+    for (; i < n; ++i)
+        tb->base[tb->row[i].id] = b;
+
+    /* Make room for every lookup, including those of the columns after
+       the last entry of a row.  */
+    tb->size = 0;
+    for (i = 0; i < n; ++i) {
+        ncols = i < tb->nstates ? tb->nterms + 1 : tb->nstates;
+        if (tb->base[i] + ncols > tb->size)
+            tb->size = tb->base[i] + ncols;
+    }
+
+    return ensure_size(tb, tb->size);
+}
+
+/* Get the smallest C type, holding the values up to MAX.  */
+static const char *
+c_type(unsigned long max) {
+    if (max <= 0xff)
+        return "unsigned char";
+    else if (max <= 0xffff)
+        return "unsigned short";
+    else
+        return "unsigned int";
+}
+
+/* Output the N values at V as the array NAME of the type TYPE or, if
+   TYPE is null, of the smallest type, holding the values.  */
+void
+xg_gen_c_array(FILE *out,
+               const char *type,
+               const char *name,
+               const unsigned int *v,
+               unsigned int n) {
+    unsigned int i, max;
+
+    if (type == 0) {
+        for (i = max = 0; i < n; ++i)
+            if (v[i] > max)
+                max = v[i];
+        type = c_type(max);
+    }
+
+    fprintf(out, "static const %s %s [] =\n{", type, name);
+    for (i = 0; i < n; ++i)
+        fprintf(out, "%s%u%s", i % 12 == 0 ? "\n  " : " ", v[i], i + 1 < n ? "," : "");
+    fputs("\n};\n\n", out);
+}
+
+/* Output the tables.  */
+static int
+emit_tables(FILE *out, const tables *tb, const xg_grammar *g) {
+    unsigned int i, n, maxtok, *v;
+    const xg_prod *p;
+
+    maxtok = g->terms[tb->nterms - 1];
+    n = tb->nprods > maxtok + 1 ? tb->nprods : maxtok + 1;
+    if ((v = xg_malloc(xg_mem_output, n * sizeof(unsigned int))) == 0)
+        return -1;
+
+    fprintf(out,
+            "#define XG__NSTATES %u\n"
+            "#define XG__NPRODS %u\n"
+            "#define XG__NTERMS %u\n"
+            "#define XG__MAX_TOKEN %u\n\n",
+            tb->nstates,
+            tb->nprods,
+            tb->nterms,
+            maxtok);
+
+    for (i = 0; i <= maxtok; ++i)
+        v[i] = g->termno[i] != XG_NO_TERM ? g->termno[i] : tb->nterms;
+    xg_gen_c_array(out, 0, "xg__translate", v, maxtok + 1);
+
+    xg_gen_c_array(out, 0, "xg__action_base", tb->base, tb->nstates);
+    xg_gen_c_array(out, 0, "xg__defact", tb->defact, tb->nstates);
+    xg_gen_c_array(out, 0, "xg__goto_base", tb->base + tb->nstates, tb->nnts);
+    xg_gen_c_array(out, 0, "xg__defgoto", tb->defgoto, tb->nnts);
+    xg_gen_c_array(out, 0, "xg__check", tb->check, tb->size);
+    xg_gen_c_array(out, 0, "xg__table", tb->value, tb->size);
+
+    for (i = 0; i < tb->nprods; ++i)
+        v[i] = xg_prod_length(xg_grammar_get_prod(g, i));
+    xg_gen_c_array(out, 0, "xg__prod_length", v, tb->nprods);
+
+    /* Production 0 is never reduced.  */
+    v[0] = 0;
+    for (i = 1; i < tb->nprods; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        v[i] = tb->ntno[p->lhs];
+    }
+    xg_gen_c_array(out, 0, "xg__prod_lhs", v, tb->nprods);
+
+    xg_free(v);
+    return 0;
+}
+
+/* Output the parser function, counting the visits if INSTRUMENT is
+   non-zero.  */
+static void
+emit_driver(FILE *out, int instrument) {
+    fputs(
+        "int\n"
+        "xg_parse (xg_parse_ctx *ctx)\n"
+        "{\n"
+        "  /* Next state, terminal number of the token and parse action.  */\n"
+        "  unsigned int next, term, act;\n\n"
+        "  XG__PARSER_FUNCTION_INIT;\n\n"
+        "  next = 0;\n"
+        "  term = XG__TERM (token);\n"
+        "  for (;;)\n"
+        "    {\n"
+        "      XG__PUSH (next);\n",
+        out);
+    if (instrument)
+        fputs("      XG__COUNT (xg__count_state[next]);\n", out);
+    fputs(
+        "      act = XG__ACTION (state, term);\n",
+        out);
+    if (instrument)
+        fputs("      XG__COUNT (xg__count_action[state * (XG__NTERMS + 1) + term]);\n", out);
+    fputs(
+        "      if (act < XG__NSTATES)\n"
+        "        {\n"
+        "          next = act;\n"
+        "          XG__SHIFT;\n",
+        out);
+    if (instrument)
+        fputs("          XG__SAMPLE_DEPTH ();\n", out);
+    fputs(
+        "          term = XG__TERM (token);\n"
+        "        }\n"
+        "      else if (act > XG__ACCEPT && act < XG__ERROR)\n"
+        "        {\n"
+        "          act -= XG__NSTATES;\n"
+        "          XG__REDUCE (act, xg__prod_length[act]);\n",
+        out);
+    if (instrument)
+        fputs(
+            "          XG__COUNT (xg__count_prod[act]);\n"
+            "          XG__COUNT (xg__count_symbol[xg__prod_lhs[act]]);\n",
+            out);
+    fputs(
+        "          next = XG__GOTO (state, xg__prod_lhs[act]);\n"
+        "          if (xg__stack_ensure (&stk) < 0)\n"
+        "            goto internal_error;\n"
+        "        }\n"
+        "      else if (act == XG__ACCEPT)\n"
+        "        goto accept;\n"
+        "      else\n"
+        "        goto parse_error;\n"
+        "    }\n\n",
+        out);
+
+    fputs(
+        "internal_error:\n"
+        "  XG__PARSER_FUNCTION_END (-1);\n\n",
+        out);
+    fputs(
+        "parse_error:\n"
+        "  XG__PARSER_FUNCTION_END (-1);\n\n",
+        out);
+    fputs(
+        "accept:\n"
+        "  XG__PARSER_FUNCTION_END (0);\n",
+        out);
+    fputs("}\n", out);
+}
+
+/* Release the memory, used by the tables.  */
+static void
+destroy_tables(tables *tb) {
+    ulib_vector_destroy(&tb->ent);
+    xg_free(tb->ntno);
+    xg_free(tb->row);
+    xg_free(tb->first);
+    xg_free(tb->base);
+    xg_free(tb->defact);
+    xg_free(tb->defgoto);
+    xg_free(tb->check);
+    xg_free(tb->value);
+    xg_free(tb->used);
+}
+
+/* Number the non-terminals of the grammar G, except the start symbol,
+   in the order of their codes.  Return an array with the number of
+   each symbol, which is zero for the other symbols, and set *COUNT to
+   the number of the non-terminals.  Return null on error.  */
+unsigned int *
+xg_gen_c_nonterminals(const xg_grammar *g, unsigned int *count) {
+    unsigned int i, n, *ntno;
+
+    n = xg_grammar_symbol_count(g);
+    if ((ntno = xg_malloc(xg_mem_output, n * sizeof(unsigned int))) == 0)
+        return 0;
+
+    *count = 0;
+    for (i = 0; i < n; ++i)
+        ntno[i] = (i > XG_TOKEN_LITERAL_MAX && !xg_grammar_is_terminal_sym(g, i)
+                           && (xg_sym)i != g->start
+                       ? (*count)++
+                       : 0);
+
+    return ntno;
+}
+
+/* Output the parse tables of a table driven parser.  */
+int
+xg_gen_c_parse_tables(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa) {
+    unsigned int i, n, *scratch;
+    tables tb;
+    const table_ent *ent;
+    int sts = -1;
+
+    memset(&tb, 0, sizeof(tb));
+    (void)ulib_vector_init(&tb.ent, ULIB_ELT_SIZE, sizeof(table_ent), 0);
+    scratch = 0;
+
+    tb.nstates = xg_lr0dfa_state_count(dfa);
+    tb.nprods = xg_grammar_prod_count(g);
+    tb.nterms = g->nterms;
+    if ((tb.ntno = xg_gen_c_nonterminals(g, &tb.nnts)) == 0)
+        goto error;
+
+    n = tb.nstates + tb.nnts;
+    if ((tb.row = xg_calloc(xg_mem_output, n, sizeof(table_row))) == 0
+        || (tb.first = xg_calloc(xg_mem_output, n + 1, sizeof(unsigned int))) == 0
+        || (tb.base = xg_calloc(xg_mem_output, n, sizeof(unsigned int))) == 0
+        || (tb.defact = xg_calloc(xg_mem_output, tb.nstates, sizeof(unsigned int))) == 0
+        || (tb.defgoto = xg_calloc(xg_mem_output, tb.nnts + 1, sizeof(unsigned int))) == 0
+        || (scratch = xg_malloc(xg_mem_output,
+                                (tb.nterms > tb.nstates ? tb.nterms : tb.nstates)
+                                    * sizeof(unsigned int)))
+               == 0)
+        goto error;
+
+    if (make_action_rows(&tb, g, dfa, scratch) < 0
+        || make_goto_rows(&tb, g, dfa, scratch) < 0)
+        goto error;
+
+    /* The entries are complete, point the rows to them.  */
+    tb.first[n] = ulib_vector_length(&tb.ent);
+    ent = ulib_vector_front(&tb.ent);
+    for (i = 0; i < n; ++i) {
+        tb.row[i].id = i;
+        tb.row[i].nent = tb.first[i + 1] - tb.first[i];
+        tb.row[i].ent = ent + tb.first[i];
+    }
+
+    if (pack_rows(&tb) < 0 || emit_tables(out, &tb, g) < 0)
+        goto error;
+
+    xg_stat_add(xg_stat_table_entries, tb.size);
+    sts = 0;
+
+error:
+    if (sts < 0)
+        ulib_log_printf(xg_log, "ERROR: Unable to create the parse tables");
+    xg_free(scratch);
+    destroy_tables(&tb);
+    return sts;
+}
+
+int
+xg_gen_c_tables(FILE *out,
+                const xg_grammar *g,
+                const xg_lr0dfa *dfa,
+                const xg_gen_c_options *opt) {
+    if (opt->instrument)
+        fputs("#define XG__INSTRUMENT 1\n", out);
+
+    /* Include the common parser declarations.  */
+    fputs("#include <xg-c-parser.h>\n\n", out);
+
+    /* Emit symbol names and productions.  */
+    xg_gen_c_debug_names(out, g);
+
+    if (xg_gen_c_parse_tables(out, g, dfa) < 0)
+        return -1;
+
+    if (opt->instrument)
+        xg_gen_c_counters(out, g, xg_lr0dfa_state_count(dfa), 0, 1);
+    emit_driver(out, opt->instrument);
+    if (opt->instrument) {
+        fputs("\n", out);
+        xg_gen_c_dump_profile(out, g, xg_lr0dfa_state_count(dfa), 0, 0, 0, 1);
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
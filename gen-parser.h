@@ -22,11 +22,84 @@
 #define xg_gen_c_slr_h 1
 
 #include "lr0.h"
+#include "profile.h"
 
 BEGIN_DECLS
 
-/* Generate a SLR(1) or LALR(1) parser in ISO C.  */
-int xg_gen_c_parser(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa);
+/* Parser generation options.  */
+struct xg_gen_c_options {
+    /* Profile of the parser or null, and the percentage of the state
+       visits, covered by the hot states.  */
+    const xg_profile *prof;
+    unsigned int coverage;
+
+    /* Instrument the parser with visit counters.  */
+    int instrument;
+
+    /* Dispatch the transitions on non-terminals with computed gotos.  */
+    int computed_goto;
+};
+typedef struct xg_gen_c_options xg_gen_c_options;
+
+/* Generate a SLR(1) or LALR(1) parser in ISO C.  With a profile,
+   only the hot states, which account for the given percent of the
+   state visits, get their own code; the others are interpreted from
+   parse tables.  */
+int xg_gen_c_parser(FILE *out,
+                    const xg_grammar *g,
+                    const xg_lr0dfa *dfa,
+                    const xg_gen_c_options *opt);
+
+/* Generate a table driven SLR(1) or LALR(1) parser in ISO C.  The
+   action and goto tables are packed into a single comb vector.  */
+int xg_gen_c_tables(FILE *out,
+                    const xg_grammar *g,
+                    const xg_lr0dfa *dfa,
+                    const xg_gen_c_options *opt);
+
+/* Output the parse tables of a table driven parser.  */
+int xg_gen_c_parse_tables(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa);
+
+/* Number the non-terminals of the grammar G, except the start symbol,
+   in the order of their codes.  Return an array with the number of
+   each symbol, which is zero for the other symbols, and set *COUNT to
+   the number of the non-terminals.  Return null on error.  */
+unsigned int *xg_gen_c_nonterminals(const xg_grammar *g, unsigned int *count);
+
+/* Output the N values at V as the array NAME of the type TYPE or, if
+   TYPE is null, of the smallest type, holding the values.  */
+void xg_gen_c_array(FILE *out,
+                    const char *type,
+                    const char *name,
+                    const unsigned int *v,
+                    unsigned int n);
+
+/* Output the visit counters of an instrumented parser with NSTATES
+   states and NCASES switch cases.  If ACTIONS is non-zero, the parser
+   is table driven and counts the actions of each state on each
+   terminal.  */
+void xg_gen_c_counters(FILE *out,
+                       const xg_grammar *g,
+                       unsigned int nstates,
+                       unsigned int ncases,
+                       int actions);
+
+/* Output the function, which writes the profile of an instrumented
+   parser.  The NCASES switch cases are in the states CASE_STATE and
+   are taken on the tokens CASE_TOKEN, or by default if the token is
+   negative.  If ACTIONS is non-zero, the parser is table driven and
+   counts the actions of each state on each terminal.  */
+void xg_gen_c_dump_profile(FILE *out,
+                           const xg_grammar *g,
+                           unsigned int nstates,
+                           unsigned int ncases,
+                           const unsigned int *case_state,
+                           const int *case_token,
+                           int actions);
+
+/* Output the names of the symbols and the productions, used by the
+   debugging code of a parser.  */
+void xg_gen_c_debug_names(FILE *out, const xg_grammar *g);
 
 END_DECLS
 #endif /* xg_gen_c_slr_h */
@@ -30,26 +30,26 @@ static ulib_cache *symdef_cache;
 /* Symbol definition constructor.  */
 static int
 symdef_ctor(xg_symdef *def, unsigned int sz __attribute__((unused))) {
-    (void)ulib_bitset_init(&def->first);
-    (void)ulib_bitset_init(&def->follow);
+    def->first = def->follow = 0;
     (void)ulib_vector_init(&def->prods, ULIB_ELT_SIZE, sizeof(unsigned), 0);
+    (void)ulib_vector_init(&def->closure, ULIB_ELT_SIZE, sizeof(unsigned), 0);
     return 0;
 }
 
 /* Symbol definition destruction.  */
 static void
 symdef_clear(xg_symdef *def, unsigned int sz __attribute__((unused))) {
-    free(def->name);
-    ulib_bitset_clear_all(&def->first);
-    ulib_bitset_clear_all(&def->follow);
+    xg_free(def->name);
+    def->first = def->follow = 0;
+    xg_mem_account(xg_mem_symdef, -(long)sizeof(xg_symdef));
     ulib_vector_set_size(&def->prods, 0);
+    ulib_vector_set_size(&def->closure, 0);
 }
 
 static void
 symdef_dtor(xg_symdef *def, unsigned int sz __attribute__((unused))) {
-    ulib_bitset_destroy(&def->first);
-    ulib_bitset_destroy(&def->follow);
     ulib_vector_destroy(&def->prods);
+    ulib_vector_destroy(&def->closure);
 }
 
 /* Create a symbol definition (consume the argument).  */
@@ -58,6 +58,7 @@ xg_symdef_new(char *name) {
     xg_symdef *def;
 
     if ((def = ulib_cache_alloc(symdef_cache)) != 0) {
+        xg_mem_account(xg_mem_symdef, sizeof(xg_symdef));
         def->code = 0;
         def->name = name;
         def->terminal = xg_implicit_terminal;
@@ -79,7 +80,7 @@ xg_symdef_new_copy(const char *_name) {
     xg_symdef *def;
 
     n = strlen(_name);
-    if ((name = xg_malloc(n + 1)) != 0) {
+    if ((name = xg_malloc(xg_mem_symdef, n + 1)) != 0) {
         memcpy(name, _name, n + 1);
         if ((def = xg_symdef_new(name)) != 0)
             return def;
@@ -117,9 +118,11 @@ xg_prod_new(xg_sym lhs) {
 
     prod = ulib_cache_alloc(prod_cache);
     if (prod != 0) {
+        xg_mem_account(xg_mem_prod, sizeof(xg_prod));
         prod->lhs = lhs;
         (void)ulib_vector_init(&prod->rhs, ULIB_ELT_SIZE, sizeof(xg_sym), 0);
         prod->prec = XG_EPSILON;
+        prod->item = 0;
         return prod;
     }
 
@@ -138,6 +141,7 @@ prod_ctor(xg_prod *prod, unsigned int sz __attribute__((unused))) {
 static void
 prod_clear(xg_prod *prod, unsigned int sz __attribute((unused))) {
     ulib_vector_set_size(&prod->rhs, 0);
+    xg_mem_account(xg_mem_prod, -(long)sizeof(xg_prod));
 }
 
 static void
@@ -206,8 +210,18 @@ xg_grammar_new() {
     xg_grammar *g;
     xg_symdef *rsv, *err, *eof, *eps;
 
-    if ((g = xg_malloc(sizeof(xg_grammar))) != 0) {
+    if ((g = xg_malloc(xg_mem_grammar, sizeof(xg_grammar))) != 0) {
         g->start = 0;
+        g->nitems = 0;
+        g->items = 0;
+        g->nterms = 0;
+        g->terms = 0;
+        g->termno = 0;
+        g->termset_words = 0;
+        g->first_sets = 0;
+        g->follow_sets = 0;
+        g->suffix_nullable = 0;
+        g->suffix_first = 0;
         (void)ulib_vector_init(&g->syms, ULIB_DATA_PTR_VECTOR, 0);
         if (ulib_vector_resize(&g->syms, XG_TOKEN_LITERAL_MAX + 1) == 0) {
             if ((rsv = xg_symdef_new_copy("<reserved>")) != 0
@@ -243,6 +257,13 @@ void
 xg_grammar_del(xg_grammar *g) {
     ulib_vector_destroy(&g->syms);
     ulib_vector_destroy(&g->prods);
+    xg_free(g->items);
+    xg_free(g->terms);
+    xg_free(g->termno);
+    xg_free(g->first_sets);
+    xg_free(g->follow_sets);
+    xg_free(g->suffix_nullable);
+    xg_free(g->suffix_first);
     ulib_gcunroot(g);
     xg_free(g);
 }
@@ -305,6 +326,125 @@ xg_grammar_get_prod(const xg_grammar *g, unsigned int n) {
     return (xg_prod *)ulib_vector_ptr_elt(&g->prods, n);
 }
 
+/* Number the LR(0) items of all productions.  */
+int
+xg_grammar_number_items(xg_grammar *g) {
+    unsigned int i, j, n, m, cnt;
+    xg_prod *p;
+    xg_item *it;
+
+    /* Count the items.  */
+    cnt = 0;
+    n = xg_grammar_prod_count(g);
+    for (i = 0; i < n; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        p->item = cnt;
+        cnt += xg_prod_length(p) + 1;
+    }
+
+    if ((it = xg_realloc(xg_mem_grammar, g->items, cnt * sizeof(xg_item))) == 0) {
+        ulib_log_printf(xg_log, "ERROR: Unable to allocate LR(0) items");
+        return -1;
+    }
+    g->items = it;
+    g->nitems = cnt;
+
+    /* Describe each item.  */
+    for (i = 0; i < n; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        m = xg_prod_length(p);
+        for (j = 0; j <= m; ++j, ++it) {
+            it->prod = i;
+            it->dot = j;
+            it->sym = j < m ? xg_prod_get_symbol(p, j) : XG_EPSILON;
+        }
+    }
+
+    return 0;
+}
+
+/* Get LR(0) item count.  */
+unsigned int
+xg_grammar_item_count(const xg_grammar *g) {
+    return g->nitems;
+}
+
+/* Number the terminals, which can be elements of a terminal set, and
+   allocate the FIRST and FOLLOW sets of the non-terminals.  */
+int
+xg_grammar_number_terminals(xg_grammar *g) {
+    unsigned int i, j, n, m, nsyms, nnts;
+    xg_sym sym;
+    xg_symdef *def;
+    const xg_prod *p;
+
+    nsyms = xg_grammar_symbol_count(g);
+    xg_free(g->termno);
+    xg_free(g->terms);
+    xg_free(g->first_sets);
+    xg_free(g->follow_sets);
+    g->terms = 0;
+    g->first_sets = g->follow_sets = 0;
+    if ((g->termno = xg_malloc(xg_mem_grammar, nsyms * sizeof(unsigned int))) == 0)
+        goto error;
+
+    /* Mark the terminals, which appear in a production, as well as the
+     end of input and the empty symbol.  */
+    for (i = 0; i < nsyms; ++i)
+        g->termno[i] = XG_NO_TERM;
+    g->termno[XG_EOF] = g->termno[XG_EPSILON] = 0;
+
+    n = xg_grammar_prod_count(g);
+    for (i = 0; i < n; ++i) {
+        p = xg_grammar_get_prod(g, i);
+        m = xg_prod_length(p);
+        for (j = 0; j < m; ++j) {
+            sym = xg_prod_get_symbol(p, j);
+            if (xg_grammar_is_terminal_sym(g, sym))
+                g->termno[sym] = 0;
+        }
+    }
+
+    /* Number the marked terminals in the order of their codes and
+     count the non-terminals.  */
+    g->nterms = nnts = 0;
+    for (i = 0; i < nsyms; ++i) {
+        if (g->termno[i] != XG_NO_TERM)
+            g->termno[i] = g->nterms++;
+        else if (i > XG_TOKEN_LITERAL_MAX && !xg_grammar_is_terminal_sym(g, i))
+            ++nnts;
+    }
+
+    if ((g->terms = xg_malloc(xg_mem_grammar, g->nterms * sizeof(xg_sym))) == 0)
+        goto error;
+    for (i = 0; i < nsyms; ++i)
+        if (g->termno[i] != XG_NO_TERM)
+            g->terms[g->termno[i]] = i;
+
+    /* Allocate the FIRST and FOLLOW sets.  */
+    g->termset_words = xg_termset_words(g->nterms);
+    n = nnts * g->termset_words + 1;
+    if ((g->first_sets = xg_calloc(xg_mem_sets, n, sizeof(xg_termset_word))) == 0
+        || (g->follow_sets = xg_calloc(xg_mem_sets, n, sizeof(xg_termset_word))) == 0)
+        goto error;
+
+    n = 0;
+    for (i = XG_TOKEN_LITERAL_MAX + 1; i < nsyms; ++i) {
+        if (!xg_grammar_is_terminal_sym(g, i)) {
+            def = xg_grammar_get_symbol(g, i);
+            def->first = g->first_sets + n;
+            def->follow = g->follow_sets + n;
+            n += g->termset_words;
+        }
+    }
+
+    return 0;
+
+error:
+    ulib_log_printf(xg_log, "ERROR: Unable to number the terminals");
+    return -1;
+}
+
 /* Return true if the symbol SYM is a terminal.  */
 int
 xg_grammar_is_terminal_sym(const xg_grammar *g, xg_sym sym) {
@@ -355,38 +495,9 @@ init_caches(void) {
     return -1;
 }
 
-static int
-init_bitsets(void) {
-    ulib_bitset *eps_set, *eof_set;
-
-    if ((eps_set = malloc(sizeof(ulib_bitset))) != 0) {
-        (void)ulib_bitset_init(eps_set);
-        if (ulib_bitset_set(eps_set, XG_EPSILON) == 0) {
-            if ((eof_set = malloc(sizeof(ulib_bitset))) != 0) {
-                (void)ulib_bitset_init(eof_set);
-                if (ulib_bitset_set(eof_set, XG_EOF) == 0) {
-                    xg_epsilon_set = eps_set;
-                    xg_eof_set = eof_set;
-                    return 0;
-                }
-                ulib_bitset_destroy(eof_set);
-                free(eof_set);
-            }
-        }
-        ulib_bitset_destroy(eps_set);
-        free(eps_set);
-    }
-
-    ulib_log_printf(xg_log, "ERROR: Unable to create the terminal sets");
-    return -1;
-}
-
 int
 xg__init_grammar(void) {
-    if (init_caches() < 0 || init_bitsets() < 0)
-        return -1;
-    else
-        return 0;
+    return init_caches();
 }
 
 void
@@ -406,15 +517,16 @@ xg_symbol_name_debug(FILE *out, const xg_grammar *g, xg_sym sym) {
 }
 
 void
-xg_symset_debug(FILE *out, const xg_grammar *g, const ulib_bitset *set) {
-    unsigned int i, n;
-
-    n = ulib_bitset_max(set);
-    for (i = 0; i < n; ++i) {
-        if (ulib_bitset_is_set(set, i)) {
-            xg_symbol_name_debug(out, g, i);
-            fputc(' ', out);
-        }
+xg_termset_debug(FILE *out,
+                 const xg_grammar *g,
+                 const xg_termset_word *set,
+                 unsigned int n) {
+    unsigned int t;
+
+    for (t = xg_termset_next(set, 0, n); t < n * XG_TERMSET_WORD_BITS;
+         t = xg_termset_next(set, t + 1, n)) {
+        xg_symbol_name_debug(out, g, g->terms[t]);
+        fputc(' ', out);
     }
     fputc('\n', out);
 }
@@ -456,10 +568,10 @@ xg_symdef_debug(FILE *out, const xg_grammar *g, const xg_symdef *def) {
         }
 
         fprintf(out, "\tFIRST: ");
-        xg_symset_debug(out, g, &def->first);
+        xg_termset_debug(out, g, def->first, g->termset_words);
 
         fprintf(out, "\tFOLLOW: ");
-        xg_symset_debug(out, g, &def->follow);
+        xg_termset_debug(out, g, def->follow, g->termset_words);
     }
 }
 
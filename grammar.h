@@ -24,6 +24,8 @@
 #include <ulib/vector.h>
 #include <ulib/list.h>
 #include <ulib/bitset.h>
+#include "laset.h"
+#include "termset.h"
 
 #include <stdio.h>
 
@@ -41,11 +43,9 @@ typedef int xg_sym;
 /* Epsilon (empty sequence) code.  */
 #define XG_EPSILON 1
 
-/* A terminal set, containing only the empty symbol.  */
-extern const ulib_bitset *xg_epsilon_set;
-
-/* A terminal set, containing only the end of input symbol.  */
-extern const ulib_bitset *xg_eof_set;
+/* Terminal number of the symbols, which cannot be an element of a
+   terminal set.  */
+#define XG_NO_TERM (~0U)
 
 /* Symbol associativity.  */
 enum xg_assoc { xg_assoc_unknown, xg_assoc_none, xg_assoc_left, xg_assoc_right };
@@ -65,14 +65,19 @@ struct xg_symdef {
     char *name;
 
     /* FIRST set (for non-terminal symbols).  */
-    ulib_bitset first;
+    xg_termset_word *first;
 
     /* FOLLOW set (for non-terminal symbols).  */
-    ulib_bitset follow;
+    xg_termset_word *follow;
 
     /* All productions, having this symbol as their left hand side.  */
     ulib_vector prods;
 
+    /* Initial LR(0) items (with the dot at the front), which belong to
+       the closure of an item with the dot in front of this symbol (for
+       non-terminal symbols).  */
+    ulib_vector closure;
+
     /* Terminal flag.  */
     unsigned int terminal : 2;
 
@@ -112,6 +117,9 @@ struct xg_prod {
 
     /* Rightmost terminal.  */
     xg_sym prec;
+
+    /* Number of the LR(0) item with the dot at the front.  */
+    unsigned int item;
 };
 typedef struct xg_prod xg_prod;
 
@@ -131,6 +139,19 @@ xg_sym xg_prod_get_symbol(const xg_prod *, unsigned int n);
 /* Get the right hand side of a production.  */
 xg_sym *xg_prod_get_symbols(const xg_prod *);
 
+/* LR(0) item description.  */
+struct xg_item {
+    /* Production number.  */
+    unsigned int prod;
+
+    /* Dot position.  */
+    unsigned int dot;
+
+    /* Symbol after the dot or XG_EPSILON if the dot is at the end.  */
+    xg_sym sym;
+};
+typedef struct xg_item xg_item;
+
 /* Grammar.  */
 struct xg_grammar {
     /* Start symbol code.  */
@@ -141,9 +162,58 @@ struct xg_grammar {
 
     /* All productions.  */
     ulib_vector prods;
+
+    /* Number of LR(0) items.  */
+    unsigned int nitems;
+
+    /* All LR(0) items.  The items of each production are numbered
+       consecutively, in the order of the dot position.  */
+    xg_item *items;
+
+    /* Number of terminals, which can be elements of a terminal set:
+       the end of input, the empty symbol and the terminals, which
+       appear in a production.  */
+    unsigned int nterms;
+
+    /* Terminal set elements, in ascending order of their codes.  */
+    xg_sym *terms;
+
+    /* Terminal number of each symbol or XG_NO_TERM.  */
+    unsigned int *termno;
+
+    /* Number of words in a terminal set.  */
+    unsigned int termset_words;
+
+    /* FIRST sets of all the non-terminals.  */
+    xg_termset_word *first_sets;
+
+    /* FOLLOW sets of all the non-terminals.  */
+    xg_termset_word *follow_sets;
+
+    /* For each LR(0) item, whether the symbols after the dot derive
+       the empty string.  */
+    unsigned char *suffix_nullable;
+
+    /* For each LR(0) item, the FIRST set of the symbols after the dot,
+       without epsilon.  */
+    const xg_laset **suffix_first;
 };
 typedef struct xg_grammar xg_grammar;
 
+/* Check whether the symbols of the production P from the position N to
+   the end derive the empty string.  */
+static inline int
+xg_prod_nullable_suffix(const xg_grammar *g, const xg_prod *p, unsigned int n) {
+    return g->suffix_nullable[p->item + n];
+}
+
+/* Get the FIRST set of the symbols of the production P from the
+   position N to the end, without epsilon.  */
+static inline const xg_laset *
+xg_prod_first_suffix(const xg_grammar *g, const xg_prod *p, unsigned int n) {
+    return g->suffix_first[p->item + n];
+}
+
 /* Create an empty grammar structure.  */
 xg_grammar *xg_grammar_new();
 
@@ -176,6 +246,16 @@ unsigned int xg_grammar_prod_count(const xg_grammar *);
 /* Get Nth production.  */
 xg_prod *xg_grammar_get_prod(const xg_grammar *, unsigned int n);
 
+/* Number the LR(0) items of all productions.  */
+int xg_grammar_number_items(xg_grammar *g);
+
+/* Get LR(0) item count.  */
+unsigned int xg_grammar_item_count(const xg_grammar *g);
+
+/* Number the terminals, which can be elements of a terminal set, and
+   allocate the FIRST and FOLLOW sets of the non-terminals.  */
+int xg_grammar_number_terminals(xg_grammar *g);
+
 /* Print a production.  */
 void xg_prod_print(FILE *out, const xg_grammar *g, const xg_prod *p);
 
@@ -185,9 +265,25 @@ int xg_grammar_is_terminal_sym(const xg_grammar *g, xg_sym sym);
 /* Compute the FIRST set for each non-terminal.  */
 int xg_grammar_compute_first(const xg_grammar *g);
 
-/* Compute the FOLLOW set for each non-terminal.  */
+/* Release the FIRST sets of the non-terminals.  */
+void xg_grammar_release_first(xg_grammar *g);
+
+/* Compute the nullable flag and the FIRST set of each production
+   suffix.  The FIRST set is a prerequisite for calling this
+   function.  */
+int xg_grammar_compute_suffixes(xg_grammar *g);
+
+/* Release the nullable flags and the FIRST sets of the production
+   suffixes.  */
+void xg_grammar_release_suffixes(xg_grammar *g);
+
+/* Compute the FOLLOW set for each non-terminal.  The production
+   suffixes are a prerequisite for calling this function.  */
 int xg_grammar_compute_follow(const xg_grammar *g);
 
+/* Release the FOLLOW sets of the non-terminals.  */
+void xg_grammar_release_follow(xg_grammar *g);
+
 /* Check whether the symbol S is nullable.  */
 int xg_nullable_sym(const xg_grammar *g, xg_sym s);
 
@@ -203,8 +299,11 @@ int xg_make_random_sentence(FILE *out, const xg_grammar *g, unsigned int size, i
 /* Display a symbol name.  */
 void xg_symbol_name_debug(FILE *out, const xg_grammar *g, xg_sym sym);
 
-/* Display a set of symbols.  */
-void xg_symset_debug(FILE *out, const xg_grammar *g, const ulib_bitset *set);
+/* Display a terminal set of N words.  */
+void xg_termset_debug(FILE *out,
+                      const xg_grammar *g,
+                      const xg_termset_word *set,
+                      unsigned int n);
 
 /* Display a debugging dump of a symbol.  */
 void xg_symdef_debug(FILE *out, const xg_grammar *g, const xg_symdef *def);
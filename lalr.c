@@ -30,108 +30,259 @@
  */
 
 #include "lalr.h"
+#include "pool.h"
 #include "xg.h"
-#include <ulib/cache.h>
+#include <assert.h>
+#include <string.h>
+
+/* A ``lookback'' of the reduction number REDUCT in the state STATE to
+   the LALR(1) transition TRANS.  */
+struct lalr_lookback {
+    unsigned int state;
+    unsigned int reduct;
+    unsigned int trans;
+};
+typedef struct lalr_lookback lalr_lookback;
 
-/* LALR(1) transitions cache.  */
-static ulib_cache *lalr_cache;
+/* No trie node or production.  */
+#define LALR_TRIE_NONE (~0U)
 
-/* LALR(1) transition constructor.  */
-static int
-trans_ctor(xg_lalr_trans *tr, unsigned int size __attribute__((unused))) {
-    (void)ulib_vector_init(&tr->rel, ULIB_ELT_SIZE, sizeof(unsigned int), 0);
-    (void)ulib_bitset_init(&tr->value);
-    return 0;
-}
+/* A node of the prefix trie of the right hand sides of the productions
+   of a non-terminal.  The root stands for the empty prefix, any other
+   node for the prefix of its parent, followed by SYM.  */
+struct lalr_trie_node {
+    xg_sym sym;
 
-/* LALR(1) transition clear.  */
-static void
-trans_clear(xg_lalr_trans *tr, unsigned int size __attribute__((unused))) {
-    ulib_vector_set_size(&tr->rel, 0);
-    ulib_bitset_clear_all(&tr->value);
-}
+    /* First child and next sibling.  */
+    unsigned int child;
+    unsigned int next;
 
-/* Relation destructor.  */
-static void
-trans_dtor(xg_lalr_trans *tr, unsigned int size __attribute__((unused))) {
-    ulib_vector_destroy(&tr->rel);
-    ulib_bitset_destroy(&tr->value);
+    /* First production, whose right hand side is the prefix.  */
+    unsigned int prod;
+
+    /* Non-zero if SYM is a non-terminal, followed by a nullable suffix
+       in a production, whose right hand side starts with the
+       prefix.  */
+    unsigned int includes;
+};
+typedef struct lalr_trie_node lalr_trie_node;
+
+/* A frame of the trie walk stack: a trie node and the LR(0) DFA state,
+   reached by following the prefix of the node.  */
+struct lalr_trie_frame {
+    unsigned int node;
+    unsigned int state;
+};
+typedef struct lalr_trie_frame lalr_trie_frame;
+
+/* Prefix tries of the right hand sides of the productions of all the
+   non-terminals.  The path of each production is walked from each
+   LALR(1) transition on its left hand side once, sharing the walk of
+   the common prefixes, and the walk yields both the ``includes''
+   relation and the ``lookback'' states.  */
+struct lalr_trie {
+    /* Nodes of all the tries.  */
+    unsigned int nnodes;
+    lalr_trie_node *node;
+
+    /* Trie root of each non-terminal.  */
+    unsigned int *root;
+
+    /* Next production with the same left and right hand side.  */
+    unsigned int *next_prod;
+
+    /* Position of each production among the productions of its left
+       hand side.  */
+    unsigned int *prodpos;
+
+    /* Walk stack.  */
+    lalr_trie_frame *stk;
+
+    /* Final state of the path of the production number J of the symbol
+       of the LALR(1) transition N, starting at the source state of the
+       transition, is END[BASE[N] + J].  */
+    unsigned int *base;
+    unsigned int *end;
+};
+typedef struct lalr_trie lalr_trie;
+
+/* Get the function value of the LALR(1) transition N.  */
+static inline xg_termset_word *
+trans_value(const xg_lalr_trans *la, unsigned int n) {
+    return xg_digraph_value(&la->graph, n);
 }
 
-/* Create the LALR(1) transitions array.  */
-static xg_lalr_trans *const *
-create_lalr_transitions(const xg_grammar *g, const xg_lr0dfa *dfa) {
+/* Create the LALR(1) transitions: number the non-terminal transitions
+   of the LR(0) DFA densely and allocate their function values.  */
+static int
+create_lalr_transitions(const xg_grammar *g, const xg_lr0dfa *dfa, xg_lalr_trans *la) {
     unsigned int i, n;
     const xg_lr0trans *t;
-    xg_lalr_trans **trans;
 
-    /* Allocate the LALR(1) transitions array.  */
-    if ((trans = calloc(xg_lr0dfa_trans_count(dfa), sizeof(void *))) == 0)
+    n = xg_lr0dfa_trans_count(dfa);
+    la->ntrans = 0;
+    la->map = xg_malloc(xg_mem_lalr, (n + 1) * sizeof(unsigned int));
+    la->lr0 = xg_malloc(xg_mem_lalr, (n + 1) * sizeof(unsigned int));
+    if (la->map == 0 || la->lr0 == 0)
         goto error;
 
-    /* Walk over all the non-terminal transitions in the LR(0) DFA
-     states and create an LALR(1) transition in the TRANS vector,
-     corresponding to each LR(0) transition.  */
-
-    n = xg_lr0dfa_trans_count(dfa);
+    /* Walk over all the transitions in the LR(0) DFA and assign
+     consecutive numbers to the non-terminal ones.  */
     for (i = 0; i < n; ++i) {
         t = xg_lr0dfa_get_trans(dfa, i);
-        if (!xg_grammar_is_terminal_sym(g, t->sym)
-            && (trans[i] = ulib_cache_alloc(lalr_cache)) == 0)
-            goto error;
+        if (xg_grammar_is_terminal_sym(g, t->sym))
+            la->map[i] = XG_LALR_NONE;
+        else {
+            la->map[i] = la->ntrans;
+            la->lr0[la->ntrans++] = i;
+        }
     }
 
-    return trans;
+    /* Allocate the function values of all the transitions in one
+     block.  */
+    if (xg_digraph_init(&la->graph, la->ntrans, g->termset_words) < 0)
+        goto error;
+
+    return 0;
 
 error:
+    xg_free(la->lr0);
+    xg_free(la->map);
     ulib_log_printf(xg_log, "ERROR: Unable to create LALR(1) transitions");
-    return 0;
+    return -1;
 }
 
-/* Clear relation vectors.  */
+/* Release the memory, used by the LALR(1) transitions.  */
 static void
-clear_rel(unsigned int n, xg_lalr_trans *const *trans) {
-    unsigned int i;
+destroy_lalr_transitions(xg_lalr_trans *la) {
+    xg_digraph_destroy(&la->graph);
+    xg_free(la->lr0);
+    xg_free(la->map);
+}
+
+/* Create the prefix tries of the productions' right hand sides.  */
+static int
+create_lalr_trie(const xg_grammar *g, lalr_trie *tr) {
+    unsigned int i, j, k, n, m, c, cur, last, nsyms, nprods, prod;
+    xg_sym sym;
+    const xg_symdef *def;
+    const xg_prod *p;
+    lalr_trie_node *nd;
+
+    nsyms = xg_grammar_symbol_count(g);
+    nprods = xg_grammar_prod_count(g);
+    n = xg_grammar_item_count(g) + nsyms;
+    tr->nnodes = 0;
+    tr->base = tr->end = 0;
+    tr->node = xg_malloc(xg_mem_lalr, n * sizeof(lalr_trie_node));
+    tr->stk = xg_malloc(xg_mem_lalr, n * sizeof(lalr_trie_frame));
+    tr->root = xg_malloc(xg_mem_lalr, nsyms * sizeof(unsigned int));
+    tr->next_prod = xg_malloc(xg_mem_lalr, (nprods + 1) * sizeof(unsigned int));
+    tr->prodpos = xg_malloc(xg_mem_lalr, (nprods + 1) * sizeof(unsigned int));
+    if (tr->node == 0 || tr->stk == 0 || tr->root == 0 || tr->next_prod == 0 || tr->prodpos == 0)
+        goto error;
+
+    for (i = XG_TOKEN_LITERAL_MAX + 1; i < nsyms; ++i) {
+        if (xg_grammar_is_terminal_sym(g, i))
+            continue;
 
-    for (i = 0; i < n; ++i)
-        if (trans[i])
-            ulib_vector_clear(&trans[i]->rel, 0);
+        /* Create the root.  */
+        tr->root[i] = tr->nnodes;
+        nd = &tr->node[tr->nnodes++];
+        nd->sym = XG_EPSILON;
+        nd->child = nd->next = nd->prod = LALR_TRIE_NONE;
+        nd->includes = 0;
+
+        /* Insert the right hand side of each production, sharing the
+         nodes of the common prefixes.  The children of a node are kept
+         in the order of insertion.  */
+        def = xg_grammar_get_symbol(g, i);
+        m = xg_symdef_prod_count(def);
+        for (j = 0; j < m; ++j) {
+            prod = xg_symdef_get_prod(def, j);
+            p = xg_grammar_get_prod(g, prod);
+            tr->prodpos[prod] = j;
+
+            cur = tr->root[i];
+            for (k = 0; k < xg_prod_length(p); ++k) {
+                sym = xg_prod_get_symbol(p, k);
+                last = LALR_TRIE_NONE;
+                for (c = tr->node[cur].child; c != LALR_TRIE_NONE && tr->node[c].sym != sym;
+                     c = tr->node[c].next)
+                    last = c;
+
+                if (c == LALR_TRIE_NONE) {
+                    c = tr->nnodes++;
+                    nd = &tr->node[c];
+                    nd->sym = sym;
+                    nd->child = nd->next = nd->prod = LALR_TRIE_NONE;
+                    nd->includes = 0;
+                    if (last == LALR_TRIE_NONE)
+                        tr->node[cur].child = c;
+                    else
+                        tr->node[last].next = c;
+                }
+
+                if (!xg_grammar_is_terminal_sym(g, sym) && xg_prod_nullable_suffix(g, p, k + 1))
+                    tr->node[c].includes = 1;
+                cur = c;
+            }
+
+            tr->next_prod[prod] = tr->node[cur].prod;
+            tr->node[cur].prod = prod;
+        }
+    }
+
+    return 0;
+
+error:
+    xg_free(tr->prodpos);
+    xg_free(tr->next_prod);
+    xg_free(tr->root);
+    xg_free(tr->stk);
+    xg_free(tr->node);
+    ulib_log_printf(xg_log, "ERROR: Unable to create the productions prefix trie");
+    return -1;
+}
+
+/* Release the memory, used by the prefix tries.  */
+static void
+destroy_lalr_trie(lalr_trie *tr) {
+    xg_free(tr->end);
+    xg_free(tr->base);
+    xg_free(tr->prodpos);
+    xg_free(tr->next_prod);
+    xg_free(tr->root);
+    xg_free(tr->stk);
+    xg_free(tr->node);
 }
 
 /* Initialize transitions with the DirectRead sets:
    DR (p, A) = {t in T | p -A-> r -t->.} */
 static int
-compute_direct_read_sets(const xg_grammar *g,
-                         const xg_lr0dfa *dfa,
-                         xg_lalr_trans *const *trans) {
-    unsigned int i, j, m, n;
+compute_direct_read_sets(const xg_grammar *g, const xg_lr0dfa *dfa, xg_lalr_trans *la) {
+    unsigned int i, j, m;
     const xg_lr0state *s;
     const xg_lr0trans *t;
+    xg_termset_word *value;
 
-    n = xg_lr0dfa_trans_count(dfa);
-    for (i = 0; i < n; ++i) {
+    for (i = 0; i < la->ntrans; ++i) {
         /* Follow non-terminal transitions.  */
-        t = xg_lr0dfa_get_trans(dfa, i);
-        if (!xg_grammar_is_terminal_sym(g, t->sym)) {
-            s = xg_lr0dfa_get_state(dfa, t->dst);
-
-            /* Insert all terminals, which label outgoing transitions,
-             in the TRANS [I] value.  */
-            m = xg_lr0state_trans_count(s);
-            for (j = 0; j < m; ++j) {
-                t = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(s, j));
-                if (xg_grammar_is_terminal_sym(g, t->sym)
-                    && ulib_bitset_set(&trans[i]->value, t->sym) < 0)
-                    goto error;
-            }
+        t = xg_lr0dfa_get_trans(dfa, la->lr0[i]);
+        s = xg_lr0dfa_get_state(dfa, t->dst);
+        value = trans_value(la, i);
+
+        /* Insert all terminals, which label outgoing transitions, in
+         the value of the transition I.  */
+        m = xg_lr0state_trans_count(s);
+        for (j = 0; j < m; ++j) {
+            t = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(s, j));
+            if (xg_grammar_is_terminal_sym(g, t->sym))
+                xg_termset_set(value, g->termno[t->sym]);
         }
     }
 
     return 0;
-
-error:
-    ulib_log_printf(xg_log, "ERROR: Unable to compute DR sets");
-    return -1;
 }
 
 /* Compute the ``reads'' relation:
@@ -139,29 +290,35 @@ error:
 static int
 compute_reads_relation(const xg_grammar *g,
                        const xg_lr0dfa *dfa,
-                       xg_lalr_trans *const *trans) {
-    unsigned int i, j, m, n;
+                       xg_lalr_trans *la,
+                       ulib_vector *edges) {
+    unsigned int i, j, m;
     const xg_lr0state *s;
     const xg_lr0trans *t;
+    xg_digraph_edge e;
 
-    n = xg_lr0dfa_trans_count(dfa);
-    for (i = 0; i < n; ++i) {
+    ulib_vector_set_size(edges, 0);
+    for (i = 0; i < la->ntrans; ++i) {
         /* Follow non-terminal transitions.  */
-        t = xg_lr0dfa_get_trans(dfa, i);
-        if (!xg_grammar_is_terminal_sym(g, t->sym)) {
-            s = xg_lr0dfa_get_state(dfa, t->dst);
-
-            /* Find transitions with nullable non-terminals. */
-            m = xg_lr0state_trans_count(s);
-            for (j = 0; j < m; ++j) {
-                t = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(s, j));
-                if (!xg_grammar_is_terminal_sym(g, t->sym) && xg_nullable_sym(g, t->sym)
-                    && ulib_vector_append(&trans[i]->rel, &t->id) < 0)
+        t = xg_lr0dfa_get_trans(dfa, la->lr0[i]);
+        s = xg_lr0dfa_get_state(dfa, t->dst);
+
+        /* Find transitions with nullable non-terminals. */
+        m = xg_lr0state_trans_count(s);
+        for (j = 0; j < m; ++j) {
+            t = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(s, j));
+            if (!xg_grammar_is_terminal_sym(g, t->sym) && xg_nullable_sym(g, t->sym)) {
+                e.src = i;
+                e.dst = la->map[t->id];
+                if (ulib_vector_append(edges, &e) < 0)
                     goto error;
             }
         }
     }
 
+    if (xg_digraph_set_relation(&la->graph, edges) < 0)
+        goto error;
+
     return 0;
 
 error:
@@ -169,75 +326,76 @@ error:
     return -1;
 }
 
-/* Helper function to find in the state S the transition labeled
-   SYM.  */
-static xg_lr0trans *
-find_trans(const xg_lr0dfa *dfa, const xg_lr0state *s, xg_sym sym) {
-    unsigned int i, n;
-    xg_lr0trans *t;
-
-    n = xg_lr0state_trans_count(s);
-    for (i = 0; i < n; ++i) {
-        t = xg_lr0dfa_get_trans(dfa, xg_lr0state_get_trans(s, i));
-        if (t->sym == sym)
-            return t;
-    }
-
-    return 0;
-}
-
 /* Compute the  ``includes'' relation:
-   (p, A) ``includes'' (p', B) iff B->bAy, y =>* eps and p' -..b..-> p */
+   (p, A) ``includes'' (p', B) iff B->bAy, y =>* eps and p' -..b..-> p
+   For each LALR(1) transition (p', B), walk the prefix trie of the
+   productions of B from p', recording the final state of each
+   production path for the ``lookback'' relation.  */
 static int
 compute_includes_relation(const xg_grammar *g,
                           const xg_lr0dfa *dfa,
-                          xg_lalr_trans *const *trans) {
-    unsigned int i, n, j, m, k;
-    xg_lr0state *s;
-    xg_lr0trans *t, *tt;
-    const xg_sym *sym;
-    const xg_prod *p;
-    const xg_symdef *def;
+                          xg_lalr_trans *la,
+                          lalr_trie *tr,
+                          ulib_vector *edges) {
+    unsigned int i, c, top, prod;
+    const xg_lr0trans *t, *tt;
+    const lalr_trie_node *nd;
+    lalr_trie_frame f;
+    xg_digraph_edge e;
+
+    ulib_vector_set_size(edges, 0);
+
+    /* Find the position of the final states of the productions of the
+     symbol of each transition.  */
+    if ((tr->base = xg_malloc(xg_mem_lalr, (la->ntrans + 1) * sizeof(unsigned int))) == 0)
+        goto error;
+    tr->base[0] = 0;
+    for (i = 0; i < la->ntrans; ++i) {
+        t = xg_lr0dfa_get_trans(dfa, la->lr0[i]);
+        tr->base[i + 1] = tr->base[i] + xg_symdef_prod_count(xg_grammar_get_symbol(g, t->sym));
+    }
+    if ((tr->end = xg_malloc(xg_mem_lalr, (tr->base[la->ntrans] + 1) * sizeof(unsigned int))) == 0)
+        goto error;
 
-    n = xg_lr0dfa_trans_count(dfa);
-    for (i = 0; i < n; ++i) {
-        if (trans[i] == 0)
-            /* Skip non-terminal transitions.  */
-            continue;
+    for (i = 0; i < la->ntrans; ++i) {
+        t = xg_lr0dfa_get_trans(dfa, la->lr0[i]);
 
-        t = xg_lr0dfa_get_trans(dfa, i);
+        /* Follow the paths defined by the right hand sides of the
+         productions, whose left hand side is the symbol, labeling the
+         above transition.  */
+        tr->stk[0].node = tr->root[t->sym];
+        tr->stk[0].state = t->src;
+        top = 1;
+        while (top != 0) {
+            f = tr->stk[--top];
+            nd = &tr->node[f.node];
 
-        /* Process each production, whose left hand side is the symbol,
-         labeling the above transition.  */
-        def = xg_grammar_get_symbol(g, t->sym);
-        m = xg_symdef_prod_count(def);
-        for (j = 0; j < m; ++j) {
-            p = xg_grammar_get_prod(g, xg_symdef_get_prod(def, j));
-
-            /* Follow the path defined by the right hand side of the
-             production.  */
-            sym = xg_prod_get_symbols(p);
-            k = xg_prod_length(p);
-            s = xg_lr0dfa_get_state(dfa, t->src);
-            while (k > 0) {
-                tt = find_trans(dfa, s, *sym);
+            for (prod = nd->prod; prod != LALR_TRIE_NONE; prod = tr->next_prod[prod])
+                tr->end[tr->base[i] + tr->prodpos[prod]] = f.state;
+
+            for (c = nd->child; c != LALR_TRIE_NONE; c = tr->node[c].next) {
+                tt = xg_lr0dfa_find_trans(dfa, xg_lr0dfa_get_state(dfa, f.state), tr->node[c].sym);
                 assert(tt);
 
-                if (!xg_grammar_is_terminal_sym(g, *sym)
-                    && (k == 1 || xg_nullable_form(g, k - 1, sym + 1))) {
+                if (tr->node[c].includes) {
                     /* Found a state and a transition, such that
                      TT ``includes'' T  */
-                    if (ulib_vector_append(&trans[tt->id]->rel, &t->id) < 0)
+                    e.src = la->map[tt->id];
+                    e.dst = i;
+                    if (ulib_vector_append(edges, &e) < 0)
                         goto error;
                 }
 
-                s = xg_lr0dfa_get_state(dfa, tt->dst);
-                ++sym;
-                --k;
+                tr->stk[top].node = c;
+                tr->stk[top].state = tt->dst;
+                ++top;
             }
         }
     }
 
+    if (xg_digraph_set_relation(&la->graph, edges) < 0)
+        goto error;
+
     return 0;
 
 error:
@@ -246,212 +404,182 @@ error:
 }
 
 /* Compute the lookahead sets:
-   LA (q, A->w) = U{Follow (p, A) | p -..w..-> q} */
+   LA (q, A->w) = U{Follow (p, A) | p -..w..-> q}
+   The sets are first accumulated in a temporary array and then each
+   one is replaced by the shared lookahead set with the same
+   elements.  */
 static int
-compute_lookaheads(const xg_grammar *g, xg_lr0dfa *dfa, xg_lalr_trans *const *trans) {
-    unsigned int stateno, nstates, nitems, nfins, plen;
-    xg_lr0state *start, *end;
-    xg_lr0trans *t;
+compute_lookaheads(const xg_grammar *g,
+                   xg_lr0dfa *dfa,
+                   const xg_lalr_trans *la,
+                   const lalr_trie *tr) {
+    int sts = -1;
+    unsigned int i, n, stateno, nstates, nitems, nfins, plen, prod, *base = 0;
+    xg_lr0state *start, *end, *scratch;
+    const xg_lr0state *items;
+    const xg_lr0trans *t, *tt;
     xg_lr0reduct *rd;
     const xg_lr0item *it, *fin;
     const xg_prod *p;
     xg_sym *sym;
+    xg_termset_word *value = 0;
+    const lalr_lookback *lb;
+    lalr_lookback l;
+    ulib_vector lookback;
+
+    (void)ulib_vector_init(&lookback, ULIB_ELT_SIZE, sizeof(lalr_lookback), 0);
+
+    if ((scratch = xg_lr0state_new()) == 0)
+        goto exit;
 
     /* Walk over the non-kernel items in each LR(0) DFA state.  */
     nstates = xg_lr0dfa_state_count(dfa);
     for (stateno = 0; stateno < nstates; ++stateno) {
         start = xg_lr0dfa_get_state(dfa, stateno);
+        if ((items = xg_lr0dfa_state_closure(g, dfa, start, scratch)) == 0)
+            goto exit;
 
-        nitems = xg_lr0state_item_count(start);
-        it = xg_lr0state_items_front(start);
+        nitems = xg_lr0state_item_count(items);
+        it = xg_lr0state_items_front(items);
         for (; nitems--; ++it) {
-            if (it->dot)
+            if (xg_lr0item_dot(g, *it))
                 /* Skip kernel items.  */
                 continue;
 
-            /* Trace the path, defined by the item production's right
-             hand side, to the state, which contains the final item
-             for the production.  */
-            p = xg_grammar_get_prod(g, it->prod);
-
-            plen = xg_prod_length(p);
-            sym = xg_prod_get_symbols(p);
-            end = start;
-            while (plen--) {
-                t = find_trans(dfa, end, *sym);
-                end = xg_lr0dfa_get_state(dfa, t->dst);
-                ++sym;
+            /* Find the state, which contains the final item for the
+             production, at the end of the path, defined by the item
+             production's right hand side.  The path was already
+             walked, unless the state is accepting.  */
+            prod = xg_lr0item_prod(g, *it);
+            p = xg_grammar_get_prod(g, prod);
+            t = xg_lr0dfa_find_trans(dfa, start, p->lhs);
+            if (t != 0) {
+                n = tr->base[la->map[t->id]] + tr->prodpos[prod];
+                end = xg_lr0dfa_get_state(dfa, tr->end[n]);
+            } else {
+                plen = xg_prod_length(p);
+                sym = xg_prod_get_symbols(p);
+                end = start;
+                while (plen--) {
+                    tt = xg_lr0dfa_find_trans(dfa, end, *sym);
+                    end = xg_lr0dfa_get_state(dfa, tt->dst);
+                    ++sym;
+                }
             }
 
-            /* Find the final item for the production.  */
-            nfins = xg_lr0state_item_count(end);
-            fin = xg_lr0state_items_front(end);
-            while (nfins && (it->prod != fin->prod || fin->dot != xg_prod_length(p))) {
-                ++fin;
-                --nfins;
+            /* Find the final item for the production.  The final item
+             of an empty production is IT itself, which may not be
+             stored in a kernel-only state.  */
+            if (xg_prod_length(p) != 0) {
+                nfins = xg_lr0state_item_count(end);
+                fin = xg_lr0state_items_front(end);
+                while (nfins && *fin != *it + xg_prod_length(p)) {
+                    ++fin;
+                    --nfins;
+                }
+                assert(nfins != 0);
             }
-            assert(nfins != 0);
 
             /* Found a state END and a final item FIN, corresponding to
              production P, such that
              (END, P) ``lookback'' (START, lhs(P))  */
-            t = find_trans(dfa, start, p->lhs);
-            if (t == 0) {
-                /* Accepting state.  */
-                if (xg_lr0state_add_reduct(end, it->prod) == 0)
-                    goto error;
-            } else {
-                if ((rd = xg_lr0state_add_reduct(end, it->prod)) == 0
-                    || ulib_bitset_destr_or(&rd->la, &trans[t->id]->value) < 0)
-                    goto error;
+            if ((rd = xg_lr0state_add_reduct(end, prod)) == 0)
+                goto exit;
+            if (t != 0) {
+                /* Not an accepting state, record the lookback.  */
+                l.state = end->id;
+                l.reduct = rd - xg_lr0state_get_reduct(end, 0);
+                l.trans = la->map[t->id];
+                if (ulib_vector_append(&lookback, &l) < 0)
+                    goto exit;
             }
         }
     }
 
-    return 0;
-
-error:
-    ulib_log_printf(xg_log, "ERROR: Unable to compute the LALR(1) lookahead sets");
-    return -1;
-}
-
-/* Context passed around in DIGRAPH computations.  */
-struct digraph_ctx {
-    /* Number of LALR (1) transitions.  */
-    unsigned int ntrans;
-
-    /* All LALR(1) transitions (NTRANS elements).  */
-    xg_lalr_trans *const *trans;
-
-    /* Stack depth at the SCC root (NTRANS elements).  */
-    unsigned int *root;
-
-    /* Stack for SCC member candidates.  */
-    ulib_vector stk;
-};
-typedef struct digraph_ctx digraph_ctx;
-
-/* Recursive visit of the transitions in DFS order over either the
-   ``reads'' or the ``includes'' relation.  */
-static int
-digraph_visit(digraph_ctx *ctx, unsigned int no) {
-    unsigned int n, *next;
-
-    /* Push the transitions on the stack.  It's a candidate for an SCC
-     root.  */
-    if (ulib_vector_append(&ctx->stk, &no) < 0)
-        return -1;
-
-    /* Record the current stack depth.  */
-    ctx->root[no] = ulib_vector_length(&ctx->stk);
-
-    /* Traverse the sucessors of the current transition.  */
-    n = ulib_vector_length(&ctx->trans[no]->rel);
-    next = ulib_vector_front(&ctx->trans[no]->rel);
-    while (n--) {
-        if (ctx->root[*next] == 0 && digraph_visit(ctx, *next) < 0)
-            return -1;
-
-        if (ctx->root[*next] < ctx->root[no]) {
-            /* Current transition is a part of an SCC, whose root is
-             deeper in the stack.  */
-            ctx->root[no] = ctx->root[*next];
+    /* Find the position of the lookahead set of the first reduction of
+     each state.  */
+    if ((base = xg_malloc(xg_mem_lalr, (nstates + 1) * sizeof(unsigned int))) == 0)
+        goto exit;
+    base[0] = 0;
+    for (stateno = 0; stateno < nstates; ++stateno)
+        base[stateno + 1] = base[stateno]
+                            + xg_lr0state_reduct_count(xg_lr0dfa_get_state(dfa, stateno));
+
+    /* Accumulate the lookahead sets.  */
+    if ((value = xg_calloc(xg_mem_lalr, (size_t)base[nstates] * la->graph.nwords + 1, sizeof(xg_termset_word))) == 0)
+        goto exit;
+
+    n = ulib_vector_length(&lookback);
+    lb = ulib_vector_front(&lookback);
+    for (i = 0; i < n; ++i, ++lb)
+        xg_termset_or(value + (size_t)(base[lb->state] + lb->reduct) * la->graph.nwords,
+                 trans_value(la, lb->trans),
+                 la->graph.nwords);
+
+    /* Replace the lookahead sets with shared ones.  */
+    for (stateno = 0; stateno < nstates; ++stateno) {
+        end = xg_lr0dfa_get_state(dfa, stateno);
+        n = xg_lr0state_reduct_count(end);
+        for (i = 0; i < n; ++i) {
+            rd = xg_lr0state_get_reduct(end, i);
+            rd->la = xg_laset_intern(value + (size_t)(base[stateno] + i) * la->graph.nwords,
+                                     la->graph.nwords);
+            if (rd->la == 0)
+                goto exit;
         }
-
-        if (ulib_bitset_destr_or(&ctx->trans[no]->value, &ctx->trans[*next]->value) < 0)
-            return -1;
-
-        ++next;
     }
 
-    if (ctx->root[no] == ulib_vector_length(&ctx->stk)) {
-        /* Found an SCC, with the current transition being the root and
-         the transitions up the stack being the SCC members.  Pop the
-         entire SCC. */
-        do {
-            next = ulib_vector_back(&ctx->stk);
-            n = next[-1];
-            ulib_vector_remove_last(&ctx->stk);
-
-            ctx->root[n] = ~0U;
-            if (n != no
-                && ulib_bitset_copy(&ctx->trans[n]->value, &ctx->trans[no]->value) < 0)
-                return -1;
-        } while (n != no);
-    }
+    sts = 0;
 
-    return 0;
-}
-
-/* Compute the function F x = F'x U U{F'y | x R y} on the directed
-   graph defined by the relation R.  */
-static int
-digraph(digraph_ctx *ctx) {
-    unsigned int i, n;
-
-    n = ctx->ntrans;
-    for (i = 0; i < n; ++i)
-        if (ctx->root[i] == 0 && ctx->trans[i] != 0 && digraph_visit(ctx, i) < 0)
-            return -1;
-
-    return 0;
+exit:
+    xg_free(value);
+    xg_free(base);
+    ulib_vector_destroy(&lookback);
+    if (sts < 0)
+        ulib_log_printf(xg_log, "ERROR: Unable to compute the LALR(1) lookahead sets");
+    return sts;
 }
 
-/* Create reductions for an LALR(1) parser.  */
+/* Create reductions for an LALR(1) parser.  If NJOBS is greater than
+   one, propagate the lookahead sets with NJOBS threads.  */
 int
-xg_make_lalr_reductions(const xg_grammar *g, xg_lr0dfa *dfa) {
+xg_make_lalr_reductions(const xg_grammar *g, xg_lr0dfa *dfa, unsigned int njobs) {
     int sts = -1;
-    xg_lalr_trans *const *trans;
-    digraph_ctx ctx;
-
-    if ((trans = create_lalr_transitions(g, dfa))) {
-        ctx.ntrans = xg_lr0dfa_trans_count(dfa);
-        ctx.trans = trans;
-        (void)ulib_vector_init(&ctx.stk, ULIB_ELT_SIZE, sizeof(unsigned int), 0);
-        if ((ctx.root = calloc(ctx.ntrans, sizeof(unsigned int)))) {
-            /* Compute Read sets */
-            if (compute_direct_read_sets(g, dfa, trans) == 0
-                && compute_reads_relation(g, dfa, trans) == 0
-                && digraph(&ctx) == 0) {
-                /* Prepare for the next run.  */
-                memset(ctx.root, 0, ctx.ntrans * sizeof(unsigned int));
-                clear_rel(ctx.ntrans, trans);
-
-                /* Compute Follow sets */
-                if (compute_includes_relation(g, dfa, trans) == 0 && digraph(&ctx) == 0) {
-                    /* Compute lookahead sets */
-                    sts = compute_lookaheads(g, dfa, trans);
-                }
+    xg_lalr_trans la;
+    lalr_trie tr;
+    ulib_vector edges;
+    xg_pool *pool = 0;
+
+    if (create_lalr_transitions(g, dfa, &la) < 0)
+        return -1;
+    if (create_lalr_trie(g, &tr) < 0) {
+        destroy_lalr_transitions(&la);
+        return -1;
+    }
+
+    (void)ulib_vector_init(&edges, ULIB_ELT_SIZE, sizeof(xg_digraph_edge), 0);
+
+    if (njobs <= 1 || (pool = xg_pool_new(njobs)) != 0) {
+        /* Compute Read sets */
+        if (compute_direct_read_sets(g, dfa, &la) == 0
+            && compute_reads_relation(g, dfa, &la, &edges) == 0
+            && xg_digraph_run(&la.graph, pool) == 0) {
+            /* Compute Follow sets */
+            if (compute_includes_relation(g, dfa, &la, &tr, &edges) == 0
+                && xg_digraph_run(&la.graph, pool) == 0) {
+                /* Compute lookahead sets */
+                sts = compute_lookaheads(g, dfa, &la, &tr);
             }
-            free(ctx.root);
         }
-        ulib_vector_destroy(&ctx.stk);
-        free((void *)trans);
     }
+    if (pool)
+        xg_pool_del(pool);
+    ulib_vector_destroy(&edges);
+    destroy_lalr_trie(&tr);
+    destroy_lalr_transitions(&la);
     return sts;
 }
 
-int
-xg__init_lalr(void) {
-    lalr_cache = ulib_cache_create(ULIB_CACHE_SIZE,
-                                   sizeof(xg_lalr_trans),
-                                   ULIB_CACHE_ALIGN,
-                                   sizeof(void *),
-                                   ULIB_CACHE_CTOR,
-                                   trans_ctor,
-                                   ULIB_CACHE_CLEAR,
-                                   trans_clear,
-                                   ULIB_CACHE_DTOR,
-                                   trans_dtor,
-                                   ULIB_CACHE_GC,
-                                   0);
-    if (lalr_cache)
-        return 0;
-
-    ulib_log_printf(xg_log, "ERROR: Unable to create the LALR(1) transitions cache");
-    return -1;
-}
-
 /*
  * Local variables:
  * mode: C
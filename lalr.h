@@ -22,26 +22,36 @@
 #ifndef xg__lalr_h
 #define xg__lalr_h 1
 
+#include "digraph.h"
 #include "lr0.h"
-#include <ulib/vector.h>
 
 BEGIN_DECLS
 
-/* LALR(1) transition.  */
+/* LALR(1) transition number of the terminal LR(0) DFA transitions.  */
+#define XG_LALR_NONE (~0U)
+
+/* LALR(1) transitions: the non-terminal transitions of the LR(0) DFA,
+   numbered consecutively.  */
 struct xg_lalr_trans {
-    /* Related LALR transitions.  */
-    ulib_vector rel;
+    /* Number of LALR(1) transitions.  */
+    unsigned int ntrans;
+
+    /* LALR(1) transition number of each LR(0) DFA transition or
+       XG_LALR_NONE.  */
+    unsigned int *map;
 
-    /* Function value.  */
-    ulib_bitset value;
+    /* LR(0) DFA transition number of each LALR(1) transition.  */
+    unsigned int *lr0;
+
+    /* Relation between the LALR(1) transitions and their function
+       values.  */
+    xg_digraph graph;
 };
 typedef struct xg_lalr_trans xg_lalr_trans;
 
-/* Create reductions for an LALR(1) parser.  */
-int xg_make_lalr_reductions(const xg_grammar *g, xg_lr0dfa *dfa);
-
-/* Initialized the LALR(1) memory management.  */
-int xg__init_lalr(void);
+/* Create reductions for an LALR(1) parser.  If NJOBS is greater than
+   one, propagate the lookahead sets with NJOBS threads.  */
+int xg_make_lalr_reductions(const xg_grammar *g, xg_lr0dfa *dfa, unsigned int njobs);
 
 END_DECLS
 
@@ -0,0 +1,178 @@
+/* laset.c - Interned lookahead sets.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "laset.h"
+#include "xg.h"
+#include <ulib/hash.h>
+#include <string.h>
+
+/* Lookahead sets hash table directory size.  */
+#define LASET_HASH_SIZE 1021
+
+/* All the lookahead sets.  */
+static ulib_hash laset_index;
+
+/* Number of the lookahead sets.  */
+static unsigned int laset_count;
+
+const xg_laset *xg_empty_laset;
+
+/* Compute the hash value of N numbers at P, each of SZ bytes.  */
+static unsigned int
+laset_hash_bytes(const void *p, unsigned int n, unsigned int sz) {
+    unsigned int h = 2166136261U;
+    const unsigned char *b = p;
+
+    n *= sz;
+    while (n--)
+        h = (h ^ *b++) * 16777619U;
+
+    return h;
+}
+
+/* Lookahead sets hash function.  */
+static unsigned int
+laset_hash(const ulib_list *lst) {
+    return ((const xg_laset *)lst)->hash;
+}
+
+/* Lookahead sets compare function.  */
+static int
+laset_cmp(const ulib_list *a, const ulib_list *b) {
+    const xg_laset *sa = (const xg_laset *)a;
+    const xg_laset *sb = (const xg_laset *)b;
+
+    if (sa->hash != sb->hash || sa->count != sb->count || sa->nwords != sb->nwords)
+        return 1;
+
+    if (sa->nwords == 0)
+        return (sa->count != 0
+                && memcmp(sa->u.elts, sb->u.elts, sa->count * sizeof(unsigned int)) != 0);
+    else
+        return memcmp(sa->u.words, sb->u.words, sa->nwords * sizeof(xg_termset_word)) != 0;
+}
+
+/* Get the lookahead set, containing the bits set in the NWORDS words at
+   WORDS.  Return null on error.  */
+const xg_laset *
+xg_laset_intern(const xg_termset_word *words, unsigned int nwords) {
+    unsigned int i, t, sz, elts[XG_LASET_SPARSE_MAX];
+    xg_laset key, *set;
+    void *copy;
+
+    /* Drop the trailing zero words and choose the representation.  */
+    while (nwords != 0 && words[nwords - 1] == 0)
+        --nwords;
+
+    key.count = xg_termset_count(words, nwords);
+    if (key.count <= XG_LASET_SPARSE_MAX
+        && key.count * sizeof(unsigned int) <= nwords * sizeof(xg_termset_word)) {
+        for (i = 0, t = 0; i < key.count; ++i, ++t)
+            elts[i] = t = xg_termset_next(words, t, nwords);
+        key.nwords = 0;
+        key.u.elts = elts;
+        key.hash = laset_hash_bytes(elts, key.count, sizeof(unsigned int));
+        sz = key.count * sizeof(unsigned int);
+    } else {
+        key.nwords = nwords;
+        key.u.words = words;
+        key.hash = laset_hash_bytes(words, nwords, sizeof(xg_termset_word));
+        sz = nwords * sizeof(xg_termset_word);
+    }
+
+    if ((set = (xg_laset *)ulib_hash_lookup(&laset_index, &key.list)) != 0)
+        return set;
+
+    /* Not found, create a new set.  The elements follow the set
+       structure.  */
+    if ((set = xg_malloc(xg_mem_laset, sizeof(xg_laset) + sz)) == 0) {
+        ulib_log_printf(xg_log, "ERROR: Unable to create a lookahead set");
+        return 0;
+    }
+
+    copy = set + 1;
+    if (sz != 0)
+        memcpy(copy, key.nwords == 0 ? (const void *)key.u.elts : (const void *)key.u.words, sz);
+    set->hash = key.hash;
+    set->count = key.count;
+    set->nwords = key.nwords;
+    if (key.nwords == 0)
+        set->u.elts = copy;
+    else
+        set->u.words = copy;
+    ulib_hash_insert(&laset_index, &set->list);
+    ++laset_count;
+
+    return set;
+}
+
+/* Get the lookahead set, containing the elements of SET, except ELT.
+   Return null on error.  */
+const xg_laset *
+xg_laset_remove(const xg_laset *set, unsigned int elt) {
+    unsigned int i, n;
+    xg_termset_word *words;
+    const xg_laset *res;
+
+    if (!xg_laset_is_set(set, elt))
+        return set;
+
+    /* Copy on write.  */
+    n = set->nwords != 0 ? set->nwords : xg_termset_words(set->u.elts[set->count - 1] + 1);
+    if ((words = xg_calloc(xg_mem_laset, n, sizeof(xg_termset_word))) == 0)
+        return 0;
+
+    if (set->nwords != 0)
+        xg_termset_copy(words, set->u.words, n);
+    else
+        for (i = 0; i < set->count; ++i)
+            xg_termset_set(words, set->u.elts[i]);
+    xg_termset_clear(words, elt);
+
+    res = xg_laset_intern(words, n);
+    xg_free(words);
+
+    return res;
+}
+
+/* Get the number of distinct lookahead sets.  */
+unsigned int
+xg_laset_count(void) {
+    return laset_count;
+}
+
+/* Initialize the lookahead sets memory management.  */
+int
+xg__init_laset(void) {
+    if (ulib_hash_init(&laset_index, LASET_HASH_SIZE, laset_hash, laset_cmp) == 0
+        && (xg_empty_laset = xg_laset_intern(0, 0)) != 0)
+        return 0;
+
+    ulib_log_printf(xg_log, "ERROR: Unable to create the lookahead sets table");
+    return -1;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,145 @@
+/* laset.h - Interned lookahead sets declarations.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef xg__laset_h
+#define xg__laset_h 1
+
+#include "termset.h"
+#include <ulib/list.h>
+
+BEGIN_DECLS
+
+/* Maximum number of elements of a sparse lookahead set.  */
+#define XG_LASET_SPARSE_MAX 16
+
+/* Returned by XG_LASET_NEXT after the last element.  */
+#define XG_LASET_END (~0U)
+
+/* A set of lookahead terminals, indexed by terminal numbers.
+   Lookahead sets are interned: equal sets are represented by a single
+   object, which is never modified or released.  The sets are not safe
+   to create concurrently.
+
+   A set with few elements is sparse: it keeps its elements in an
+   ascending array, if the array is smaller than the bitmap of the set.
+   Other sets are dense and keep a bitmap.  The representation depends
+   only on the elements.  */
+struct xg_laset {
+    /* Linked list for the lookahead sets hash table.  */
+    ulib_list list;
+
+    /* Hash value of the elements.  */
+    unsigned int hash;
+
+    /* Number of elements.  */
+    unsigned int count;
+
+    /* Number of bitmap words, the last one is non-zero, or zero for a
+       sparse set.  */
+    unsigned int nwords;
+
+    /* Elements of a sparse set or the bitmap of a dense one.  */
+    union {
+        const unsigned int *elts;
+        const xg_termset_word *words;
+    } u;
+};
+typedef struct xg_laset xg_laset;
+
+/* The empty lookahead set.  */
+extern const xg_laset *xg_empty_laset;
+
+/* Get the lookahead set, containing the bits set in the NWORDS words at
+   WORDS.  Return null on error.  */
+const xg_laset *xg_laset_intern(const xg_termset_word *words, unsigned int nwords);
+
+/* Get the lookahead set, containing the elements of SET, except ELT.
+   Return null on error.  */
+const xg_laset *xg_laset_remove(const xg_laset *set, unsigned int elt);
+
+/* Get the number of distinct lookahead sets.  */
+unsigned int xg_laset_count(void);
+
+/* Check if ELT is an element of SET.  */
+static inline int
+xg_laset_is_set(const xg_laset *set, unsigned int elt) {
+    unsigned int i;
+
+    if (set->nwords == 0) {
+        for (i = 0; i < set->count && set->u.elts[i] <= elt; ++i)
+            if (set->u.elts[i] == elt)
+                return 1;
+        return 0;
+    }
+
+    return elt / XG_TERMSET_WORD_BITS < set->nwords && xg_termset_is_set(set->u.words, elt);
+}
+
+/* Add the elements of SET to the terminal set WORDS, which has room
+   for all of them.  */
+static inline void
+xg_laset_or(xg_termset_word *words, const xg_laset *set) {
+    unsigned int i;
+
+    if (set->nwords == 0) {
+        for (i = 0; i < set->count; ++i)
+            xg_termset_set(words, set->u.elts[i]);
+    } else
+        xg_termset_or(words, set->u.words, set->nwords);
+}
+
+/* Check if SET is empty.  */
+static inline int
+xg_laset_is_empty(const xg_laset *set) {
+    return set->count == 0;
+}
+
+/* Get the elements of SET in ascending order.  *POS is the position of
+   the next element, zero for the first one, and is advanced past the
+   returned element.  Return XG_LASET_END after the last element.  */
+static inline unsigned int
+xg_laset_next(const xg_laset *set, unsigned int *pos) {
+    unsigned int t;
+
+    if (set->nwords == 0)
+        return *pos < set->count ? set->u.elts[(*pos)++] : XG_LASET_END;
+
+    t = xg_termset_next(set->u.words, *pos, set->nwords);
+    if (t >= set->nwords * XG_TERMSET_WORD_BITS)
+        return XG_LASET_END;
+
+    *pos = t + 1;
+    return t;
+}
+
+/* Initialize the lookahead sets memory management.  */
+int xg__init_laset(void);
+
+END_DECLS
+
+#endif /* xg__laset_h */
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
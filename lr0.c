@@ -22,9 +22,14 @@
 #include "lr0.h"
 #include "grammar.h"
 #include "xg.h"
+#include "pool.h"
 #include <ulib/cache.h>
 #include <ulib/log.h>
 #include <ulib/bitset.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
 
 /* LR(0) states cache.  */
 static ulib_cache *lr0state_cache;
@@ -34,6 +39,7 @@ static int
 lr0state_ctor(xg_lr0state *state, unsigned int size __attribute__((unused))) {
     (void)ulib_vector_init(&state->items, ULIB_ELT_SIZE, sizeof(xg_lr0item), 0);
     (void)ulib_vector_init(&state->tr, ULIB_ELT_SIZE, sizeof(unsigned int), 0);
+    (void)ulib_vector_init(&state->trsym, ULIB_ELT_SIZE, sizeof(xg_lr0trans_ent), 0);
     (void)ulib_vector_init(&state->rd, ULIB_ELT_SIZE, sizeof(xg_lr0reduct), 0);
     return 0;
 }
@@ -41,19 +47,11 @@ lr0state_ctor(xg_lr0state *state, unsigned int size __attribute__((unused))) {
 /* LR(0) state clear.  */
 static void
 lr0state_clear(xg_lr0state *state, unsigned int size __attribute__((unused))) {
-    unsigned int n;
-    xg_lr0reduct *rd;
-
     ulib_vector_set_size(&state->items, 0);
     ulib_vector_set_size(&state->tr, 0);
-
-    n = ulib_vector_length(&state->rd);
-    rd = ulib_vector_front(&state->rd);
-    while (n--) {
-        ulib_bitset_destroy(&rd->la);
-        ++rd;
-    }
+    ulib_vector_set_size(&state->trsym, 0);
     ulib_vector_set_size(&state->rd, 0);
+    xg_mem_account(xg_mem_lr0state, -(long)sizeof(xg_lr0state));
 }
 
 /* LR(0) state destructor.  */
@@ -61,6 +59,7 @@ static void
 lr0state_dtor(xg_lr0state *state, unsigned int size __attribute__((unused))) {
     ulib_vector_destroy(&state->items);
     ulib_vector_destroy(&state->tr);
+    ulib_vector_destroy(&state->trsym);
     ulib_vector_destroy(&state->rd);
 }
 
@@ -70,41 +69,37 @@ xg_lr0state_new() {
     xg_lr0state *state;
 
     if ((state = ulib_cache_alloc(lr0state_cache)) != 0) {
+        xg_mem_account(xg_mem_lr0state, sizeof(xg_lr0state));
         state->acc = XG_EPSILON;
         state->accept = 0;
+        state->kernel = 0;
         return state;
     }
 
-    ulib_log_printf(xg_log, "ERROR: Unable to allocate an LR(0) state");
+    xg_log_printf("ERROR: Unable to allocate an LR(0) state");
     return 0;
 }
 
-/* Add the item <PROD,DOT> to the state, if not already present.
-   Return negative on error, positive if the state changed (item not
-   present) or zero otherwise.  */
+/* Add the item IT to the state, if not already present.  Return
+   negative on error, positive if the state changed (item not present)
+   or zero otherwise.  */
 int
-xg_lr0state_add_item(xg_lr0state *state, unsigned int prod, unsigned int dot) {
+xg_lr0state_add_item(xg_lr0state *state, xg_lr0item item) {
     unsigned int i, n;
-    xg_lr0item *it;
+    const xg_lr0item *it;
 
     /* Check for duplicates. */
     n = ulib_vector_length(&state->items);
     it = ulib_vector_front(&state->items);
     for (i = 0; i < n; ++i, ++it)
-        if (it->prod == prod && it->dot == dot)
+        if (*it == item)
             return 0;
 
     /* Append the new item.  */
-    if (ulib_vector_resize(&state->items, 1) == 0) {
-        it = ulib_vector_back(&state->items);
-
-        it[-1].prod = prod;
-        it[-1].dot = dot;
-
+    if (ulib_vector_append(&state->items, &item) == 0)
         return 1;
-    }
 
-    ulib_log_printf(xg_log, "ERROR: Unable to append an LR(0) item");
+    xg_log_printf("ERROR: Unable to append an LR(0) item");
     return -1;
 }
 
@@ -134,22 +129,67 @@ xg_lr0state_items_back(const xg_lr0state *state) {
     return ulib_vector_back(&state->items);
 }
 
-/* Add a transition to an LR(0) state.  */
-int
-xg_lr0state_add_trans(xg_lr0state *state, unsigned int no) {
-    if (ulib_vector_append(&state->tr, &no) < 0) {
-        ulib_log_printf(xg_log, "ERROR: Unable to append an LR(0) DFA transition");
-        return -1;
+/* Find the position of the first entry in the transitions index of
+   STATE with a symbol, not less than SYM.  */
+static unsigned int
+lr0state_trsym_lower_bound(const xg_lr0state *state, xg_sym sym) {
+    unsigned int lo, hi, mid;
+    const xg_lr0trans_ent *ent;
+
+    ent = ulib_vector_front(&state->trsym);
+    lo = 0;
+    hi = ulib_vector_length(&state->trsym);
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (ent[mid].sym < sym)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
+    return lo;
+}
+
+/* Insert the transition T into the transitions index of STATE.  */
+static int
+lr0state_index_trans(xg_lr0state *state, const xg_lr0trans *t) {
+    unsigned int i, n;
+    xg_lr0trans_ent *ent;
+
+    /* Transitions are added in no particular order, but a state has
+     few of them, so shifting the entries is cheap enough.  */
+    n = ulib_vector_length(&state->trsym);
+    i = lr0state_trsym_lower_bound(state, t->sym);
+    if (ulib_vector_resize(&state->trsym, 1) < 0)
+        return -1;
+
+    ent = ulib_vector_front(&state->trsym);
+    memmove(ent + i + 1, ent + i, (n - i) * sizeof(xg_lr0trans_ent));
+    ent[i].sym = t->sym;
+    ent[i].id = t->id;
+
     return 0;
 }
 
 /* Remove a transition from an LR(0) state.  */
 void
 xg_lr0state_del_trans(xg_lr0state *state, unsigned int idx) {
-    if (idx < ulib_vector_length(&state->tr))
+    unsigned int i, n, id;
+    const xg_lr0trans_ent *ent;
+
+    if (idx < ulib_vector_length(&state->tr)) {
+        id = xg_lr0state_get_trans(state, idx);
         ulib_vector_remove(&state->tr, idx);
+
+        n = ulib_vector_length(&state->trsym);
+        ent = ulib_vector_front(&state->trsym);
+        for (i = 0; i < n; ++i) {
+            if (ent[i].id == id) {
+                ulib_vector_remove(&state->trsym, i);
+                break;
+            }
+        }
+    }
 }
 
 /* Get the number of transitions.  */
@@ -164,6 +204,21 @@ xg_lr0state_get_trans(const xg_lr0state *state, unsigned int n) {
     return *(unsigned int *)ulib_vector_elt(&state->tr, n);
 }
 
+/* Find the transition on the symbol SYM from an LR(0) state.  Return
+   the transition ID or negative if not found.  */
+int
+xg_lr0state_find_trans(const xg_lr0state *state, xg_sym sym) {
+    unsigned int i;
+    const xg_lr0trans_ent *ent;
+
+    i = lr0state_trsym_lower_bound(state, sym);
+    if (i == ulib_vector_length(&state->trsym))
+        return -1;
+
+    ent = ulib_vector_elt(&state->trsym, i);
+    return ent->sym == sym ? (int)ent->id : -1;
+}
+
 /* Add a reduction to an LR(0) state.  If a reduction on PROD already
    exists, return a pointer to the existing reduction, otherwise
    create a new one.  Return null on error.  */
@@ -184,25 +239,20 @@ xg_lr0state_add_reduct(xg_lr0state *state, unsigned int prod) {
         rd = (xg_lr0reduct *)ulib_vector_back(&state->rd) - 1;
 
         rd->prod = prod;
-        (void)ulib_bitset_init(&rd->la);
+        rd->la = xg_empty_laset;
 
         return rd;
     }
 
-    ulib_log_printf(xg_log, "ERROR: Unable to append an LR(0) DFA reduction");
+    xg_log_printf("ERROR: Unable to append an LR(0) DFA reduction");
     return 0;
 }
 
 /* Delete the N-th reduction from an LR(0) state.  */
 void
 xg_lr0state_del_reduct(xg_lr0state *state, unsigned int n) {
-    xg_lr0reduct *rd;
-
-    if (n < ulib_vector_length(&state->rd)) {
-        rd = ulib_vector_elt(&state->rd, n);
-        ulib_bitset_destroy(&rd->la);
+    if (n < ulib_vector_length(&state->rd))
         ulib_vector_remove(&state->rd, n);
-    }
 }
 
 /* Get the number of reductions.  */
@@ -217,79 +267,154 @@ xg_lr0state_get_reduct(const xg_lr0state *state, unsigned int n) {
     return ulib_vector_elt(&state->rd, n);
 }
 
-/* Sort the items in an LR(0) state.  */
-static void
-lr0state_sort(xg_lr0state *state) {
-    unsigned int i, n, tmp;
-    xg_lr0item *a, *b;
+/* Sequences of LR(0) items, shorter than this, are sorted by
+   insertion.  */
+#define LR0ITEM_RADIX_SORT_MIN 64
 
-    n = xg_lr0state_item_count(state);
-    while (n--) {
-        a = xg_lr0state_get_item(state, 0);
+/* Sort N LR(0) items in ascending order.  Short sequences are sorted
+   by insertion, longer ones by an LSD radix sort on 8-bit digits,
+   skipping the digits, which are the same in all the items.  The
+   vector BUF of LR(0) items is the scratch space of the radix sort.  */
+static int
+lr0item_sort(unsigned int n, xg_lr0item *items, ulib_vector *buf) {
+    unsigned int i, j, k, shift, cnt[256];
+    xg_lr0item x, diff, *src, *dst, *tmp;
+
+    if (n < LR0ITEM_RADIX_SORT_MIN) {
         for (i = 1; i < n; ++i) {
-            b = xg_lr0state_get_item(state, i);
+            x = items[i];
+            for (j = i; j > 0 && items[j - 1] > x; --j)
+                items[j] = items[j - 1];
+            items[j] = x;
+        }
+        return 0;
+    }
 
-            if (a->dot < b->dot || (a->dot == b->dot && a->prod > b->prod)) {
-                tmp = a->dot;
-                a->dot = b->dot;
-                b->dot = tmp;
+    if (ulib_vector_length(buf) < n && ulib_vector_set_size(buf, n) < 0) {
+        xg_log_printf("ERROR: Unable to sort LR(0) items");
+        return -1;
+    }
 
-                tmp = a->prod;
-                a->prod = b->prod;
-                b->prod = tmp;
-            }
+    /* Find the bits, which differ among the items.  */
+    diff = 0;
+    for (i = 1; i < n; ++i)
+        diff |= items[i] ^ items[0];
+
+    src = items;
+    dst = ulib_vector_front(buf);
+    for (shift = 0; shift < 32; shift += 8) {
+        if (((diff >> shift) & 0xff) == 0)
+            continue;
 
-            a = b;
+        /* Count the digits and compute the position of the first item
+         with each digit.  */
+        memset(cnt, 0, sizeof(cnt));
+        for (i = 0; i < n; ++i)
+            ++cnt[(src[i] >> shift) & 0xff];
+        for (i = 0, k = 0; i < 256; ++i) {
+            j = cnt[i];
+            cnt[i] = k;
+            k += j;
         }
+
+        /* Distribute the items.  */
+        for (i = 0; i < n; ++i)
+            dst[cnt[(src[i] >> shift) & 0xff]++] = src[i];
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
     }
+
+    if (src != items)
+        memcpy(items, src, n * sizeof(xg_lr0item));
+
+    return 0;
 }
 
-/* Compute the closure of an LR(0) state.  */
+/* Append the item IT to the state, without checking for
+   duplicates.  */
+static int
+lr0state_append_item(xg_lr0state *state, xg_lr0item it) {
+    if (ulib_vector_append(&state->items, &it) == 0)
+        return 0;
+
+    xg_log_printf("ERROR: Unable to append an LR(0) item");
+    return -1;
+}
+
+/* Compute the closure of an LR(0) state.  The items, already in the
+   state, become its kernel.  The set DONE contains the initial items,
+   which are already in the state.  It is empty on entry and on
+   exit.  BUF is the scratch space for sorting the items.  */
 static int
-lr0state_closure(const xg_grammar *g, xg_lr0state *state, ulib_bitset *done) {
-    unsigned int i, j, n;
+lr0state_closure(const xg_grammar *g,
+                 xg_lr0state *state,
+                 ulib_bitset *done,
+                 ulib_vector *buf) {
+    int sts = -1;
+    unsigned int i, j, n, m;
+    const xg_lr0item *it, *cl;
     xg_sym sym;
-    xg_symdef *def;
-    const xg_lr0item *it;
-    const xg_prod *p;
+    const xg_symdef *def;
 
-    /* Get the next LR(0) item.  If the dot is in front of a terminal,
-     skip the item, otherwise add to the state an item with the dot at
-     the front for each production having the symbol as its left hand
-     side.  Do not add duplicate items.  */
-    for (i = 0; i < xg_lr0state_item_count(state); ++i) {
-        /* Get next item, the production and the symbol following the
-         dot.  */
+    /* Sort the kernel and record the initial items in it.  */
+    m = xg_lr0state_item_count(state);
+    state->kernel = m;
+    if (lr0item_sort(m, xg_lr0state_items_front(state), buf) < 0)
+        return -1;
+    for (i = 0; i < m; ++i) {
         it = xg_lr0state_get_item(state, i);
-        p = xg_grammar_get_prod(g, it->prod);
+        if (xg_lr0item_dot(g, *it) == 0 && ulib_bitset_set(done, *it) < 0)
+            goto error;
+    }
 
-        /* Do nothing if the dot is at the end of the production, in
-         front of a terninal symbol or in from the an already expanded
-         non-terminal.  */
-        if (it->dot >= xg_prod_length(p))
-            continue;
-        sym = xg_prod_get_symbol(p, it->dot);
-        if (xg_grammar_is_terminal_sym(g, sym) || ulib_bitset_is_set(done, sym))
+    /* For each item with the dot in front of a non-terminal, add the
+     initial items in the closure set of the non-terminal.  The
+     closure sets are transitive, so there's no need to look at the
+     newly added items.  */
+    for (i = 0; i < m; ++i) {
+        /* Do nothing if the dot is at the end of the production or in
+         front of a terninal symbol.  */
+        it = xg_lr0state_get_item(state, i);
+        sym = xg_lr0item_sym(g, *it);
+        if (xg_grammar_is_terminal_sym(g, sym))
             continue;
 
-        /* Add the non-terminal to the done set.  */
-        if (ulib_bitset_set(done, sym) < 0) {
-            ulib_log_printf(xg_log,
-                            "ERROR: Unable to add to the done set while"
-                            " computing LR(0) closure");
-            return -1;
+        /* Append the LR(0) items, skipping duplicates.  */
+        def = xg_grammar_get_symbol(g, sym);
+        n = ulib_vector_length(&def->closure);
+        cl = ulib_vector_front(&def->closure);
+        for (j = 0; j < n; ++j, ++cl) {
+            if (ulib_bitset_is_set(done, *cl))
+                continue;
+            if (ulib_bitset_set(done, *cl) < 0)
+                goto error;
+            if (lr0state_append_item(state, *cl) < 0)
+                goto exit;
         }
+    }
 
-        /* Append items LR(0) items.  */
-        def = xg_grammar_get_symbol(g, sym);
-        n = xg_symdef_prod_count(def);
-        for (j = 0; j < n; ++j)
-            if (xg_lr0state_add_item(state, xg_symdef_get_prod(def, j), 0) < 0)
-                return -1;
+    /* Sort the closure items.  */
+    n = xg_lr0state_item_count(state);
+    if (lr0item_sort(n - m, xg_lr0state_items_front(state) + m, buf) < 0)
+        goto exit;
+
+    sts = 0;
+    goto exit;
+
+error:
+    xg_log_printf("ERROR: Unable to add to the done set while computing LR(0) closure");
+exit:
+    /* Leave the DONE set empty.  */
+    n = xg_lr0state_item_count(state);
+    it = xg_lr0state_items_front(state);
+    for (i = 0; i < n; ++i, ++it) {
+        if (xg_lr0item_dot(g, *it) == 0)
+            ulib_bitset_clear(done, *it);
     }
 
-    lr0state_sort(state);
-    return 0;
+    return sts;
 }
 
 /* Compute the closure of an LR(0) state.  */
@@ -297,88 +422,89 @@ int
 xg_lr0state_closure(const xg_grammar *g, xg_lr0state *state) {
     int sts;
     ulib_bitset done;
+    ulib_vector buf;
 
     (void)ulib_bitset_init(&done);
-    sts = lr0state_closure(g, state, &done);
+    (void)ulib_vector_init(&buf, ULIB_ELT_SIZE, sizeof(xg_lr0item), 0);
+    sts = lr0state_closure(g, state, &done, &buf);
+    ulib_vector_destroy(&buf);
     ulib_bitset_destroy(&done);
 
     return sts;
 }
 
-/* Compute the goto (STATE, SYM) function.  */
-xg_lr0state *
-xg_lr0state_goto(const xg_grammar *g, const xg_lr0state *src, xg_sym sym) {
-    unsigned int i, n;
-    xg_lr0state *dst;
-    xg_lr0item *it;
-    xg_prod *p;
+/* Compare the kernels of two LR(0) states for equality.  */
+static int
+lr0set_equal(const xg_lr0state *a, const xg_lr0state *b) {
+    return a->kernel == b->kernel
+           && memcmp(xg_lr0state_items_front(a),
+                     xg_lr0state_items_front(b),
+                     a->kernel * sizeof(xg_lr0item))
+                  == 0;
+}
 
-    if ((dst = xg_lr0state_new()) == 0)
-        return 0;
+/* Compute the hash value of the kernel items of an LR(0) state.  The
+   closure is determined by the kernel, hence the latter is enough to
+   tell the states apart.  */
+static unsigned int
+lr0state_kernel_hash(const xg_lr0state *state) {
+    unsigned int n, h;
+    const xg_lr0item *it;
 
-    n = xg_lr0state_item_count(src);
-    for (i = 0; i < n; ++i) {
-        it = xg_lr0state_get_item(src, i);
-        p = xg_grammar_get_prod(g, it->prod);
-        if (it->dot < xg_prod_length(p) && sym == xg_prod_get_symbol(p, it->dot)) {
-            if (xg_lr0state_add_item(dst, it->prod, it->dot + 1) < 0)
-                return 0;
-        }
-    }
+    h = 2166136261U;
+    n = state->kernel;
+    it = xg_lr0state_items_front(state);
+    while (n--)
+        h = (h ^ *it++) * 16777619U;
 
-    if (xg_lr0state_closure(g, dst) < 0)
-        return 0;
+    return h;
+}
 
-    return dst;
+/* LR(0) states hash function.  */
+static unsigned int
+lr0state_hash(const ulib_list *lst) {
+    return ((const xg_lr0state *)lst)->hash;
 }
 
-/* Compare two LR(0) states for equality.  */
+/* LR(0) states compare function.  */
 static int
-lr0set_equal(const xg_lr0state *a, const xg_lr0state *b) {
-    unsigned int i, n;
-    xg_lr0item *ai, *bi;
-
-    /* Sets are not equal if their sizes differ.  */
-    n = xg_lr0state_item_count(a);
-    if (n != xg_lr0state_item_count(b))
-        return 0;
-
-    /* Compare each item.  Note that the states are sorted, thus first
-     item difference indicates states differ also.  */
-    for (i = 0; i < n; ++i) {
-        ai = xg_lr0state_get_item(a, i);
-        bi = xg_lr0state_get_item(b, i);
+lr0state_cmp(const ulib_list *a, const ulib_list *b) {
+    const xg_lr0state *sa = (const xg_lr0state *)a;
+    const xg_lr0state *sb = (const xg_lr0state *)b;
 
-        if (ai->prod != bi->prod || ai->dot != bi->dot)
-            return 0;
-    }
-
-    return 1;
+    return !(sa->hash == sb->hash && lr0set_equal(sa, sb));
 }
 
-/* Display a debugging dump of an LR(0) state.  */
+/* Display a debugging dump of an LR(0) state.  If the DFA keeps only
+   kernel items, the closure of the state is computed in SCRATCH, or
+   only the kernel is shown if SCRATCH is null.  */
 void
 xg_lr0state_debug(FILE *out,
                   const struct xg_grammar *g,
                   const xg_lr0dfa *dfa,
-                  const xg_lr0state *state) {
-    unsigned int i, j, n, m;
+                  const xg_lr0state *state,
+                  xg_lr0state *scratch) {
+    unsigned int i, j, n, m, pos, term;
     xg_prod *p;
+    const xg_lr0state *items;
     const xg_lr0item *it;
     const xg_lr0trans *t;
     const xg_lr0reduct *rd;
 
     /* Dump items.  */
-    n = xg_lr0state_item_count(state);
+    if (scratch == 0 || (items = xg_lr0dfa_state_closure(g, dfa, state, scratch)) == 0)
+        items = state;
+
+    n = xg_lr0state_item_count(items);
     for (i = 0; i < n; ++i) {
-        it = xg_lr0state_get_item(state, i);
-        p = xg_grammar_get_prod(g, it->prod);
+        it = xg_lr0state_get_item(items, i);
+        p = xg_grammar_get_prod(g, xg_lr0item_prod(g, *it));
 
-        fprintf(out, "\t%-4u: ", it->prod);
+        fprintf(out, "\t%-4u: ", xg_lr0item_prod(g, *it));
         xg_symbol_name_debug(out, g, p->lhs);
         fputs(" ->", out);
 
-        for (j = 0; j < it->dot; ++j) {
+        for (j = 0; j < xg_lr0item_dot(g, *it); ++j) {
             fputc(' ', out);
             xg_symbol_name_debug(out, g, xg_prod_get_symbol(p, j));
         }
@@ -409,9 +535,14 @@ xg_lr0state_debug(FILE *out,
     n = xg_lr0state_reduct_count(state);
     for (i = 0; i < n; ++i) {
         rd = xg_lr0state_get_reduct(state, i);
-        if (!ulib_bitset_is_empty(&rd->la)) {
+        if (!xg_laset_is_empty(rd->la)) {
             fputs("\tOn ", out);
-            xg_symset_debug(out, g, &rd->la);
+            pos = 0;
+            while ((term = xg_laset_next(rd->la, &pos)) != XG_LASET_END) {
+                xg_symbol_name_debug(out, g, g->terms[term]);
+                fputc(' ', out);
+            }
+            fputc('\n', out);
             fprintf(out, "\t  reduce by production %u\n", rd->prod);
         }
     }
@@ -420,65 +551,484 @@ xg_lr0state_debug(FILE *out,
         fputs("\taccept\n", out);
 }
 
-/* Create the LR(0) DFA.  */
+/* Get the index shard for a state with the hash value H.  */
+static inline unsigned int
+lr0dfa_shard(unsigned int h) {
+    return (h ^ (h >> 16)) % XG_LR0DFA_INDEX_SHARDS;
+}
+
+/* Find a state in an LR(0) DFA, whose kernel is the same as the
+   kernel of S.  Return the index of the state or negative if not
+   found.  */
 static int
-lr0dfa_create(const xg_grammar *g, xg_lr0dfa *dfa) {
-    int ns, nt, sts = -1;
-    unsigned int i;
-    xg_lr0state *src, *dst;
+lr0dfa_find_state(xg_lr0dfa *dfa, xg_lr0state *s) {
+    xg_lr0state *old;
+
+    s->hash = lr0state_kernel_hash(s);
+    old = (xg_lr0state *)ulib_hash_lookup(&dfa->index[lr0dfa_shard(s->hash)], &s->list);
+    if (old != 0)
+        return old->id;
+
+    return -1;
+}
+
+/* Insert the state S into an LR(0) DFA.  The hash value of S must be
+   already computed by LR0DFA_FIND_STATE.  Return the index of the
+   state or negative on error.  */
+static int
+lr0dfa_insert_state(xg_lr0dfa *dfa, xg_lr0state *s) {
+    if (ulib_vector_append_ptr(&dfa->states, s) < 0)
+        return -1;
+
+    s->id = ulib_vector_length(&dfa->states) - 1;
+    ulib_hash_insert(&dfa->index[lr0dfa_shard(s->hash)], &s->list);
+    return s->id;
+}
+
+/* Return a state, containing all the LR(0) items of STATE, computing
+   the closure of a kernel-only state in SCRATCH.  DONE is an empty
+   bitset and BUF a vector of LR(0) items, used during the closure
+   computation.  */
+static const xg_lr0state *
+lr0dfa_state_closure(const xg_grammar *g,
+                     const xg_lr0dfa *dfa,
+                     const xg_lr0state *state,
+                     xg_lr0state *scratch,
+                     ulib_bitset *done,
+                     ulib_vector *buf) {
+    unsigned int n;
+
+    if (!dfa->kernel_only)
+        return state;
+
+    n = xg_lr0state_item_count(state);
+    if (ulib_vector_set_size(&scratch->items, n) < 0) {
+        xg_log_printf("ERROR: Unable to compute the closure of an LR(0) state");
+        return 0;
+    }
+    memcpy(xg_lr0state_items_front(scratch),
+           xg_lr0state_items_front(state),
+           n * sizeof(xg_lr0item));
+
+    if (lr0state_closure(g, scratch, done, buf) < 0)
+        return 0;
+
+    return scratch;
+}
+
+/* The LR(0) DFA is constructed level by level, in breadth-first order,
+   by one or more threads.  The states of a level are processed in two
+   phases: first the closures of the states are computed (unless the
+   DFA keeps only kernel items), then their successors.  During the
+   second phase, the states vector of the DFA is not modified: the new
+   states get provisional numbers from a shared counter and are put in
+   the vector at the end of the phase, while the transitions vector of
+   each state contains the provisional numbers of its successors.
+   Finally, the states are renumbered in the order of a serial
+   construction and the transitions are created.  */
+
+struct lr0worker;
+
+/* Shared context of the LR(0) DFA construction.  */
+struct lr0build {
+    const xg_grammar *g;
+    xg_lr0dfa *dfa;
+
+    /* Construction threads and their contexts, one per thread.  */
+    xg_pool *pool;
+    unsigned int nworkers;
+    struct lr0worker *w;
+
+    /* States of the current level.  */
+    xg_lr0state **level;
+    unsigned int nlevel;
+
+    /* Number of states, including the ones, created at the current
+       level.  */
+    atomic_uint nstates;
+
+    /* Serialize the access to the states cache and to the shards of
+       the DFA index.  */
+    pthread_mutex_t alloc_lock;
+    pthread_mutex_t index_lock[XG_LR0DFA_INDEX_SHARDS];
+};
+
+/* Per-thread context of the LR(0) DFA construction.  */
+struct lr0worker {
+    struct lr0build *b;
+
+    /* Scratch state for the closures of kernel-only states.  */
+    xg_lr0state *scratch;
+
+    /* Successor states, which turned out to exist already, reused for
+       the next successor kernels.  */
+    ulib_vector spare;
+
+    /* Successor kernels, indexed by symbol, and their symbols in the
+       order of first appearance.  */
+    xg_lr0state **succ;
+    ulib_vector syms;
+
+    /* Initial items, already present in the state being closed.  */
+    ulib_bitset done;
+
+    /* Scratch space for sorting LR(0) items.  */
+    ulib_vector buf;
+
+    /* States, created by this thread at the current level.  */
+    ulib_vector fresh;
+};
+
+/* Release the resources of a construction thread context.  */
+static void
+lr0worker_destroy(struct lr0worker *w) {
+    unsigned int i, n;
+
+    n = ulib_vector_length(&w->spare);
+    for (i = 0; i < n; ++i)
+        ulib_cache_free(lr0state_cache, ulib_vector_ptr_elt(&w->spare, i));
+    if (w->scratch)
+        ulib_cache_free(lr0state_cache, w->scratch);
+
+    ulib_vector_destroy(&w->spare);
+    ulib_vector_destroy(&w->fresh);
+    ulib_vector_destroy(&w->buf);
+    ulib_bitset_destroy(&w->done);
+    ulib_vector_destroy(&w->syms);
+    xg_free(w->succ);
+}
+
+/* Create a state, serializing the access to the states cache.  */
+static xg_lr0state *
+lr0worker_new_state(struct lr0worker *w) {
+    xg_lr0state *state;
+
+    pthread_mutex_lock(&w->b->alloc_lock);
+    state = xg_lr0state_new();
+    pthread_mutex_unlock(&w->b->alloc_lock);
+    return state;
+}
+
+/* Partition the items of the state SRC by the symbol following the
+   dot.  For each such symbol, create a state, containing the kernel of
+   the goto (SRC, SYM) function, and record the symbol in the order of
+   first appearance.  All the successor kernels are obtained in a
+   single pass over the items.  */
+static int
+lr0worker_partition(struct lr0worker *w, const xg_lr0state *src) {
+    unsigned int i, n;
+    const xg_grammar *g = w->b->g;
     const xg_lr0item *it, *end;
-    const xg_prod *p;
+    const xg_sym *syms;
+    xg_lr0state *dst;
     xg_sym sym;
-    ulib_bitset trans_done, closure_done;
 
-    /* Start at the closure of the LR(0) item <0, 0>.  */
-    if ((src = xg_lr0state_new()) == 0 || xg_lr0state_add_item(src, 0, 0) < 0
-        || xg_lr0state_closure(g, src) < 0
-        || xg_lr0dfa_add_state(dfa, src) < 0)
+    ulib_vector_set_size(&w->syms, 0);
+
+    it = xg_lr0state_items_front(src);
+    end = xg_lr0state_items_back(src);
+    while (it < end) {
+        if ((sym = xg_lr0item_sym(g, *it)) != XG_EPSILON) {
+            if ((dst = w->succ[sym]) == 0) {
+                /* First item with SYM after the dot, start a new
+                 successor kernel.  */
+                if ((n = ulib_vector_length(&w->spare)) != 0) {
+                    dst = ulib_vector_ptr_elt(&w->spare, n - 1);
+                    ulib_vector_remove_last(&w->spare);
+                } else if ((dst = lr0worker_new_state(w)) == 0)
+                    return -1;
+
+                w->succ[sym] = dst;
+                if (ulib_vector_append(&w->syms, &sym) < 0)
+                    goto error;
+            }
+
+            /* The items in SRC are unique, so are the ones in DST.  */
+            if (lr0state_append_item(dst, *it + 1) < 0)
+                return -1;
+        }
+        ++it;
+    }
+
+    /* The kernel and the closure of SRC are sorted separately, thus the
+     successor kernels need sorting.  */
+    n = ulib_vector_length(&w->syms);
+    syms = ulib_vector_front(&w->syms);
+    for (i = 0; i < n; ++i) {
+        dst = w->succ[syms[i]];
+        dst->kernel = xg_lr0state_item_count(dst);
+        if (lr0item_sort(dst->kernel, xg_lr0state_items_front(dst), &w->buf) < 0)
+            return -1;
+    }
+
+    return 0;
+
+error:
+    xg_log_printf("ERROR: Unable to compute LR(0) DFA transitions");
+    return -1;
+}
+
+/* Compute the successors of the state SRC, add the new ones to the
+   DFA and record the provisional numbers of all of them in the
+   transitions vector of SRC.  */
+static int
+lr0worker_goto(struct lr0worker *w, xg_lr0state *src) {
+    unsigned int i, n, k, id;
+    struct lr0build *b = w->b;
+    const xg_lr0state *items;
+    xg_lr0state *dst, *old;
+    const xg_sym *sym;
+
+    items = lr0dfa_state_closure(b->g, b->dfa, src, w->scratch, &w->done, &w->buf);
+    if (items == 0 || lr0worker_partition(w, items) < 0)
         return -1;
 
-    /* Initialize done sets.  */
-    (void)ulib_bitset_init(&trans_done);
-    (void)ulib_bitset_init(&closure_done);
+    n = ulib_vector_length(&w->syms);
+    sym = ulib_vector_front(&w->syms);
+    for (i = 0; i < n; ++i, ++sym) {
+        dst = w->succ[*sym];
+        w->succ[*sym] = 0;
+
+        /* Look for an existing state and insert the new one if not
+         found.  */
+        dst->acc = *sym;
+        dst->hash = lr0state_kernel_hash(dst);
+        k = lr0dfa_shard(dst->hash);
+
+        pthread_mutex_lock(&b->index_lock[k]);
+        old = (xg_lr0state *)ulib_hash_lookup(&b->dfa->index[k], &dst->list);
+        if (old == 0) {
+            dst->id = atomic_fetch_add(&b->nstates, 1);
+            ulib_hash_insert(&b->dfa->index[k], &dst->list);
+        }
+        pthread_mutex_unlock(&b->index_lock[k]);
+
+        if (old != 0) {
+            /* The state already exists, reuse the new one.  */
+            ulib_vector_set_size(&dst->items, 0);
+            if (ulib_vector_append_ptr(&w->spare, dst) < 0)
+                goto error;
+            id = old->id;
+        } else {
+            if (ulib_vector_append_ptr(&w->fresh, dst) < 0)
+                goto error;
+            id = dst->id;
+        }
+
+        if (ulib_vector_append(&src->tr, &id) < 0)
+            goto error;
+    }
 
-    /* Walk over unprocessed states.  */
-    for (i = 0; i < ulib_vector_length(&dfa->states); ++i) {
-        src = ulib_vector_ptr_elt(&dfa->states, i);
+    return 0;
 
-        /* Walk over the items and compute each possible transition.  */
-        it = xg_lr0state_items_front(src);
-        end = xg_lr0state_items_back(src);
-        while (it < end) {
-            p = xg_grammar_get_prod(g, it->prod);
-            if (it->dot < xg_prod_length(p)) {
-                sym = xg_prod_get_symbol(p, it->dot);
-                if (ulib_bitset_is_set(&trans_done, sym) == 0) {
-                    /* Compute the transition on SYM.  */
-                    if (ulib_bitset_set(&trans_done, sym) < 0
-                        || (dst = xg_lr0state_goto(g, src, sym)) == 0
-                        || (ns = xg_lr0dfa_add_state(dfa, dst)) < 0
-                        || (nt = xg_lr0dfa_add_trans(dfa, sym, src->id, ns)) < 0
-                        || xg_lr0state_add_trans(src, nt) < 0)
-                        goto exit;
-
-                    dst->acc = sym;
-
-                    if (sym == XG_EOF) {
-                        dst = xg_lr0dfa_get_state(dfa, ns);
-                        dst->accept = 1;
-                    }
-                }
+error:
+    xg_log_printf("ERROR: Unable to compute LR(0) DFA transitions");
+    return -1;
+}
+
+/* Compute the closure of the N-th state of the current level.  */
+static int
+lr0build_closure(void *arg, unsigned int thread, unsigned int n) {
+    struct lr0build *b = arg;
+
+    return lr0state_closure(b->g, b->level[n], &b->w[thread].done, &b->w[thread].buf);
+}
+
+/* Compute the successors of the N-th state of the current level.  */
+static int
+lr0build_goto(void *arg, unsigned int thread, unsigned int n) {
+    struct lr0build *b = arg;
+
+    return lr0worker_goto(&b->w[thread], b->level[n]);
+}
+
+/* Put the states, created at the current level, in the DFA states
+   vector at their provisional numbers.  */
+static int
+lr0build_place(struct lr0build *b) {
+    unsigned int i, j, n, m;
+    xg_lr0state **states, **fresh;
+
+    n = ulib_vector_length(&b->dfa->states);
+    m = atomic_load(&b->nstates);
+    if (ulib_vector_resize(&b->dfa->states, m - n) < 0) {
+        xg_log_printf("ERROR: Unable to add LR(0) DFA states");
+        return -1;
+    }
+
+    states = ulib_vector_front(&b->dfa->states);
+    for (i = 0; i < b->nworkers; ++i) {
+        m = ulib_vector_length(&b->w[i].fresh);
+        fresh = ulib_vector_front(&b->w[i].fresh);
+        for (j = 0; j < m; ++j)
+            states[fresh[j]->id] = fresh[j];
+        ulib_vector_set_size(&b->w[i].fresh, 0);
+    }
+
+    return 0;
+}
+
+/* Release the resources of the construction context.  */
+static void
+lr0build_destroy(struct lr0build *b) {
+    unsigned int i;
+
+    for (i = 0; i < b->nworkers; ++i)
+        lr0worker_destroy(&b->w[i]);
+    xg_free(b->w);
+
+    if (b->pool)
+        xg_pool_del(b->pool);
+
+    for (i = 0; i < XG_LR0DFA_INDEX_SHARDS; ++i)
+        pthread_mutex_destroy(&b->index_lock[i]);
+    pthread_mutex_destroy(&b->alloc_lock);
+}
+
+/* Initialize the construction context for NJOBS threads.  */
+static int
+lr0build_init(struct lr0build *b, const xg_grammar *g, xg_lr0dfa *dfa, unsigned int njobs) {
+    unsigned int i, n;
+    struct lr0worker *w;
+
+    b->g = g;
+    b->dfa = dfa;
+    b->nworkers = 0;
+    b->w = 0;
+    b->level = 0;
+    b->nlevel = 0;
+    atomic_init(&b->nstates, ulib_vector_length(&dfa->states));
+    pthread_mutex_init(&b->alloc_lock, 0);
+    for (i = 0; i < XG_LR0DFA_INDEX_SHARDS; ++i)
+        pthread_mutex_init(&b->index_lock[i], 0);
+
+    if ((b->pool = xg_pool_new(njobs)) == 0)
+        goto error;
+
+    n = xg_pool_size(b->pool);
+    if ((b->w = xg_calloc(xg_mem_lr0dfa, n, sizeof(struct lr0worker))) == 0)
+        goto error;
+
+    for (; b->nworkers < n; ++b->nworkers) {
+        w = &b->w[b->nworkers];
+        w->b = b;
+        (void)ulib_vector_init(&w->syms, ULIB_ELT_SIZE, sizeof(xg_sym), 0);
+        (void)ulib_vector_init(&w->fresh, ULIB_DATA_PTR_VECTOR, 0);
+        (void)ulib_bitset_init(&w->done);
+        (void)ulib_vector_init(&w->buf, ULIB_ELT_SIZE, sizeof(xg_lr0item), 0);
+        (void)ulib_vector_init(&w->spare, ULIB_DATA_PTR_VECTOR, 0);
+        w->scratch = 0;
+        w->succ = xg_calloc(xg_mem_lr0dfa, xg_grammar_symbol_count(g), sizeof(xg_lr0state *));
+        if (w->succ == 0 || (w->scratch = xg_lr0state_new()) == 0) {
+            lr0worker_destroy(w);
+            goto error;
+        }
+    }
+
+    return 0;
+
+error:
+    lr0build_destroy(b);
+    return -1;
+}
+
+/* Renumber the states of the DFA in breadth-first order, visiting the
+   successors of each state in the order of first appearance of the
+   transition symbols, which is the order of a serial construction, and
+   create the transitions.  */
+static int
+lr0dfa_renumber(xg_lr0dfa *dfa) {
+    int nt;
+    unsigned int i, j, k, n, m, *map, *tr;
+    xg_lr0state **states, **order, *s, *dst;
+
+    n = ulib_vector_length(&dfa->states);
+    states = ulib_vector_front(&dfa->states);
+    order = xg_malloc(xg_mem_lr0dfa, n * sizeof(xg_lr0state *));
+    map = xg_malloc(xg_mem_lr0dfa, n * sizeof(unsigned int));
+    if (order == 0 || map == 0)
+        goto error;
+
+    /* Assign the final numbers.  */
+    for (i = 1; i < n; ++i)
+        map[i] = n;
+    map[0] = 0;
+    order[0] = states[0];
+    k = 1;
+    for (i = 0; i < k; ++i) {
+        s = order[i];
+        m = ulib_vector_length(&s->tr);
+        tr = ulib_vector_front(&s->tr);
+        for (j = 0; j < m; ++j) {
+            if (map[tr[j]] == n) {
+                map[tr[j]] = k;
+                order[k++] = states[tr[j]];
             }
-            ++it;
         }
-        ulib_bitset_clear_all(&trans_done);
     }
+    assert(k == n);
 
-    sts = 0;
+    /* Create the transitions.  */
+    for (i = 0; i < n; ++i) {
+        s = order[i];
+        s->id = i;
+        m = ulib_vector_length(&s->tr);
+        tr = ulib_vector_front(&s->tr);
+        for (j = 0; j < m; ++j) {
+            dst = states[tr[j]];
+            if ((nt = xg_lr0dfa_add_trans(dfa, dst->acc, i, map[tr[j]])) < 0
+                || lr0state_index_trans(s, xg_lr0dfa_get_trans(dfa, nt)) < 0)
+                goto error;
+            tr[j] = nt;
+
+            if (dst->acc == XG_EOF)
+                dst->accept = 1;
+        }
+    }
+
+    memcpy(states, order, n * sizeof(xg_lr0state *));
+    xg_free(map);
+    xg_free(order);
+    return 0;
+
+error:
+    xg_free(map);
+    xg_free(order);
+    return -1;
+}
+
+/* Create the LR(0) DFA, using NJOBS threads.  */
+static int
+lr0dfa_create(const xg_grammar *g, xg_lr0dfa *dfa, unsigned int njobs) {
+    int sts = -1;
+    unsigned int lo, hi;
+    xg_lr0state *src;
+    struct lr0build b;
+
+    /* Start at the closure of the LR(0) item <0, 0>.  */
+    if ((src = xg_lr0state_new()) == 0
+        || xg_lr0state_add_item(src, xg_grammar_get_prod(g, 0)->item) < 0)
+        return -1;
+    src->kernel = 1;
+    if (xg_lr0dfa_add_state(dfa, src) < 0 || lr0build_init(&b, g, dfa, njobs) < 0)
+        return -1;
+
+    /* Walk over unprocessed states, one level at a time.  */
+    lo = 0;
+    while (lo < (hi = ulib_vector_length(&dfa->states))) {
+        b.level = (xg_lr0state **)ulib_vector_front(&dfa->states) + lo;
+        b.nlevel = hi - lo;
+        if ((!dfa->kernel_only && xg_pool_run(b.pool, b.nlevel, lr0build_closure, &b) < 0)
+            || xg_pool_run(b.pool, b.nlevel, lr0build_goto, &b) < 0
+            || lr0build_place(&b) < 0)
+            goto exit;
+        lo = hi;
+    }
+
+    sts = lr0dfa_renumber(dfa);
 
 exit:
-    ulib_bitset_destroy(&closure_done);
-    ulib_bitset_destroy(&trans_done);
+    lr0build_destroy(&b);
     return sts;
 }
 
@@ -499,24 +1049,58 @@ lr0dfa_gcscan(xg_lr0dfa *dfa, void **ptr, unsigned int sz) {
     return n;
 }
 
-/* Create an LR(0) DFA.  */
+/* Minimum size of the LR(0) states hash table directory.  */
+#define LR0DFA_HASH_SIZE 211
+
+/* Estimate the size of the directory of each shard of the LR(0)
+   states hash table.  The number of states is roughly proportional to
+   the number of LR(0) items in the grammar.  */
+static unsigned int
+lr0dfa_hash_size(const xg_grammar *g) {
+    unsigned int sz;
+
+    sz = xg_grammar_item_count(g) / XG_LR0DFA_INDEX_SHARDS;
+    return (sz < LR0DFA_HASH_SIZE ? LR0DFA_HASH_SIZE : sz) | 1;
+}
+
+/* Destroy the first N shards of the LR(0) DFA index.  */
+static void
+lr0dfa_destroy_index(xg_lr0dfa *dfa, unsigned int n) {
+    while (n--)
+        ulib_hash_destroy(&dfa->index[n]);
+}
+
+/* Create an LR(0) DFA.  If KERNEL_ONLY is non-zero, the states keep
+   only their kernel items and the closure is computed on demand.  The
+   states are constructed by NJOBS threads.  */
 xg_lr0dfa *
-xg_lr0dfa_new(const xg_grammar *g) {
+xg_lr0dfa_new(const xg_grammar *g, int kernel_only, unsigned int njobs) {
+    unsigned int i, sz;
     xg_lr0dfa *dfa;
 
-    if ((dfa = malloc(sizeof(xg_lr0dfa))) != 0) {
+    if ((dfa = xg_malloc(xg_mem_lr0dfa, sizeof(xg_lr0dfa))) != 0) {
+        dfa->kernel_only = (kernel_only != 0);
         (void)ulib_vector_init(&dfa->states, ULIB_DATA_PTR_VECTOR, 0);
         (void)ulib_vector_init(&dfa->trans, ULIB_ELT_SIZE, sizeof(xg_lr0trans), 0);
-        if (lr0dfa_create(g, dfa) == 0) {
-            if (ulib_gcroot(dfa, (ulib_gcscan_func)lr0dfa_gcscan) == 0)
-                return dfa;
+
+        sz = lr0dfa_hash_size(g);
+        for (i = 0; i < XG_LR0DFA_INDEX_SHARDS; ++i)
+            if (ulib_hash_init(&dfa->index[i], sz, lr0state_hash, lr0state_cmp) < 0)
+                break;
+
+        if (i == XG_LR0DFA_INDEX_SHARDS) {
+            if (lr0dfa_create(g, dfa, njobs) == 0) {
+                if (ulib_gcroot(dfa, (ulib_gcscan_func)lr0dfa_gcscan) == 0)
+                    return dfa;
+            }
         }
+        lr0dfa_destroy_index(dfa, i);
         ulib_vector_destroy(&dfa->trans);
         ulib_vector_destroy(&dfa->states);
-        free(dfa);
+        xg_free(dfa);
     }
 
-    ulib_log_printf(xg_log, "ERROR: Out of memory creating LR(0) DFA");
+    xg_log_printf("ERROR: Out of memory creating LR(0) DFA");
     return 0;
 }
 
@@ -524,9 +1108,10 @@ xg_lr0dfa_new(const xg_grammar *g) {
 void
 xg_lr0dfa_del(xg_lr0dfa *dfa) {
     ulib_gcunroot(dfa);
+    lr0dfa_destroy_index(dfa, XG_LR0DFA_INDEX_SHARDS);
     ulib_vector_destroy(&dfa->states);
     ulib_vector_destroy(&dfa->trans);
-    free(dfa);
+    xg_free(dfa);
 }
 
 /* Add a state to an LR(0) DFA.  Return an index of an LR(0) DFA
@@ -534,23 +1119,12 @@ xg_lr0dfa_del(xg_lr0dfa *dfa) {
    to S, already exists.  Return negative on error.  */
 int
 xg_lr0dfa_add_state(xg_lr0dfa *dfa, xg_lr0state *s) {
-    unsigned int n;
-    xg_lr0state **old;
+    int n;
 
-    n = ulib_vector_length(&dfa->states);
-    old = ulib_vector_front(&dfa->states);
-    while (n--) {
-        if (lr0set_equal(*old, s))
-            return old - (xg_lr0state **)ulib_vector_front(&dfa->states);
-        ++old;
-    }
+    if ((n = lr0dfa_find_state(dfa, s)) >= 0)
+        return n;
 
-    if (ulib_vector_append_ptr(&dfa->states, s) < 0)
-        return -1;
-    else {
-        s->id = ulib_vector_length(&dfa->states) - 1;
-        return s->id;
-    }
+    return lr0dfa_insert_state(dfa, s);
 }
 
 /* Get the number of LR(0) DFA states.  */
@@ -565,6 +1139,27 @@ xg_lr0dfa_get_state(const xg_lr0dfa *dfa, unsigned int n) {
     return ulib_vector_ptr_elt(&dfa->states, n);
 }
 
+/* Return a state, containing all the LR(0) items of STATE.  If the
+   DFA keeps only kernel items, the closure is computed in SCRATCH and
+   SCRATCH is returned, otherwise STATE itself is returned.  Return
+   null on error.  */
+const xg_lr0state *
+xg_lr0dfa_state_closure(const xg_grammar *g,
+                        const xg_lr0dfa *dfa,
+                        const xg_lr0state *state,
+                        xg_lr0state *scratch) {
+    const xg_lr0state *items;
+    ulib_bitset done;
+    ulib_vector buf;
+
+    (void)ulib_bitset_init(&done);
+    (void)ulib_vector_init(&buf, ULIB_ELT_SIZE, sizeof(xg_lr0item), 0);
+    items = lr0dfa_state_closure(g, dfa, state, scratch, &done, &buf);
+    ulib_vector_destroy(&buf);
+    ulib_bitset_destroy(&done);
+    return items;
+}
+
 /* Add a transition to DST on symbol SYM to the LR (0) DFA.  */
 int
 xg_lr0dfa_add_trans(xg_lr0dfa *dfa, xg_sym sym, unsigned int src, unsigned int dst) {
@@ -581,7 +1176,7 @@ xg_lr0dfa_add_trans(xg_lr0dfa *dfa, xg_sym sym, unsigned int src, unsigned int d
         return t[-1].id;
     }
 
-    ulib_log_printf(xg_log, "ERROR: Unable to create an LR(0) DFA transition");
+    xg_log_printf("ERROR: Unable to create an LR(0) DFA transition");
     return -1;
 }
 
@@ -597,31 +1192,131 @@ xg_lr0dfa_get_trans(const xg_lr0dfa *dfa, unsigned int n) {
     return ulib_vector_elt(&dfa->trans, n);
 }
 
+/* Find the transition on the symbol SYM from the state S.  Return null
+   if not found.  */
+xg_lr0trans *
+xg_lr0dfa_find_trans(const xg_lr0dfa *dfa, const xg_lr0state *s, xg_sym sym) {
+    int n;
+
+    if ((n = xg_lr0state_find_trans(s, sym)) < 0)
+        return 0;
+
+    return xg_lr0dfa_get_trans(dfa, n);
+}
+
+/* Compute the LR(0) closure set of each non-terminal: the initial
+   items of the productions of all the non-terminals, which can appear
+   leftmost in a derivation from the non-terminal, including the
+   non-terminal itself.  */
+int
+xg_grammar_compute_lr0_closure(const xg_grammar *g) {
+    int sts = -1;
+    unsigned int i, n, m;
+    xg_sym sym, lhs;
+    xg_symdef *def;
+    const xg_symdef *ldef;
+    const xg_prod *p;
+    ulib_bitset seen;
+    ulib_vector stk;
+
+    (void)ulib_bitset_init(&seen);
+    (void)ulib_vector_init(&stk, ULIB_ELT_SIZE, sizeof(xg_sym), 0);
+
+    n = xg_grammar_symbol_count(g);
+    for (sym = XG_TOKEN_LITERAL_MAX + 1; sym < (xg_sym)n; ++sym) {
+        if (xg_grammar_is_terminal_sym(g, sym))
+            continue;
+
+        def = xg_grammar_get_symbol(g, sym);
+        ulib_vector_set_size(&def->closure, 0);
+        ulib_bitset_clear_all(&seen);
+
+        /* Walk the non-terminals, which can start a sentenial form,
+         derived from SYM.  */
+        if (ulib_bitset_set(&seen, sym) < 0 || ulib_vector_append(&stk, &sym) < 0)
+            goto exit;
+        while (ulib_vector_length(&stk) != 0) {
+            lhs = *((xg_sym *)ulib_vector_back(&stk) - 1);
+            ulib_vector_remove_last(&stk);
+
+            ldef = xg_grammar_get_symbol(g, lhs);
+            m = xg_symdef_prod_count(ldef);
+            for (i = 0; i < m; ++i) {
+                p = xg_grammar_get_prod(g, xg_symdef_get_prod(ldef, i));
+                if (ulib_vector_append(&def->closure, &p->item) < 0)
+                    goto exit;
+
+                if (xg_prod_length(p) == 0)
+                    continue;
+                lhs = xg_prod_get_symbol(p, 0);
+                if (xg_grammar_is_terminal_sym(g, lhs) || ulib_bitset_is_set(&seen, lhs))
+                    continue;
+                if (ulib_bitset_set(&seen, lhs) < 0
+                    || ulib_vector_append(&stk, &lhs) < 0)
+                    goto exit;
+            }
+        }
+    }
+
+    sts = 0;
+
+exit:
+    if (sts < 0)
+        xg_log_printf("ERROR: Out of memory computing LR(0) closure sets");
+    ulib_vector_destroy(&stk);
+    ulib_bitset_destroy(&seen);
+    return sts;
+}
+
+/* Release the LR(0) closure sets of the non-terminals.  */
+void
+xg_grammar_release_lr0_closure(const xg_grammar *g) {
+    unsigned int n;
+    xg_sym sym;
+    xg_symdef *def;
+
+    n = xg_grammar_symbol_count(g);
+    for (sym = XG_TOKEN_LITERAL_MAX + 1; sym < (xg_sym)n; ++sym) {
+        if (xg_grammar_is_terminal_sym(g, sym))
+            continue;
+
+        def = xg_grammar_get_symbol(g, sym);
+        ulib_vector_destroy(&def->closure);
+        (void)ulib_vector_init(&def->closure, ULIB_ELT_SIZE, sizeof(unsigned), 0);
+    }
+}
+
 /* Create reductions for an SLR(1) parser.  */
 int
 xg_make_slr_reductions(const xg_grammar *g, xg_lr0dfa *dfa) {
     unsigned int i, n;
-    xg_lr0state *state;
+    xg_lr0state *state, *scratch;
+    const xg_lr0state *items;
     const xg_lr0item *it, *end;
     const xg_prod *p;
     const xg_symdef *def;
     xg_lr0reduct *rd;
 
+    if ((scratch = xg_lr0state_new()) == 0)
+        return -1;
+
     n = xg_lr0dfa_state_count(dfa);
 
     for (i = 0; i < n; ++i) {
         state = ulib_vector_ptr_elt(&dfa->states, i);
+        if ((items = xg_lr0dfa_state_closure(g, dfa, state, scratch)) == 0)
+            return -1;
 
         /* Walk over the final items and create each possible SLR(1)
          reduction.  */
-        it = xg_lr0state_items_front(state);
-        end = xg_lr0state_items_back(state);
+        it = xg_lr0state_items_front(items);
+        end = xg_lr0state_items_back(items);
         while (it < end) {
-            p = xg_grammar_get_prod(g, it->prod);
-            if (it->dot == xg_prod_length(p)) {
+            if (xg_lr0item_sym(g, *it) == XG_EPSILON) {
+                p = xg_grammar_get_prod(g, xg_lr0item_prod(g, *it));
                 def = xg_grammar_get_symbol(g, p->lhs);
-                if ((rd = xg_lr0state_add_reduct(state, it->prod)) == 0
-                    || ulib_bitset_copy(&rd->la, &def->follow) < 0)
+                if ((rd = xg_lr0state_add_reduct(state, xg_lr0item_prod(g, *it))) == 0
+                    || (rd->la = xg_laset_intern(def->follow, g->termset_words)) == 0)
                     return -1;
             }
             ++it;
@@ -635,7 +1330,9 @@ xg_make_slr_reductions(const xg_grammar *g, xg_lr0dfa *dfa) {
 void
 xg_lr0dfa_debug(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa) {
     unsigned int i, n;
-    xg_lr0state *state;
+    xg_lr0state *state, *scratch;
+
+    scratch = dfa->kernel_only ? xg_lr0state_new() : 0;
 
     fputs("LR(0) DFA:\n", out);
     fputs("==========\n\n", out);
@@ -644,7 +1341,7 @@ xg_lr0dfa_debug(FILE *out, const xg_grammar *g, const xg_lr0dfa *dfa) {
     for (i = 0; i < n; ++i) {
         state = xg_lr0dfa_get_state(dfa, i);
         fprintf(out, "State %u:\n", i);
-        xg_lr0state_debug(out, g, dfa, state);
+        xg_lr0state_debug(out, g, dfa, state, scratch);
         fputc('\n', out);
     }
 }
@@ -667,7 +1364,7 @@ xg__init_lr0dfa() {
     if (lr0state_cache)
         return 0;
     else {
-        ulib_log_printf(xg_log, "ERROR: Unable to create the LR(0) states cache");
+        xg_log_printf("ERROR: Unable to create the LR(0) states cache");
         return -1;
     }
 }
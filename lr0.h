@@ -23,20 +23,37 @@
 #define xg__lr0_h 1
 
 #include "grammar.h"
+#include "laset.h"
 #include <ulib/vector.h>
+#include <ulib/list.h>
+#include <ulib/hash.h>
 #include <stdio.h>
+#include <stdint.h>
 
 BEGIN_DECLS
 
-/* An LR(0) item.  */
-struct xg_lr0item {
-    /* Production number.  */
-    unsigned int prod;
-
-    /* Dot position.  */
-    unsigned int dot;
-};
-typedef struct xg_lr0item xg_lr0item;
+/* An LR(0) item: the number of the item in the grammar.  Items are
+   numbered so that the item <P,DOT> has the number P->item + DOT.  */
+typedef uint32_t xg_lr0item;
+
+/* Get the production number of an LR(0) item.  */
+static inline unsigned int
+xg_lr0item_prod(const xg_grammar *g, xg_lr0item it) {
+    return g->items[it].prod;
+}
+
+/* Get the dot position of an LR(0) item.  */
+static inline unsigned int
+xg_lr0item_dot(const xg_grammar *g, xg_lr0item it) {
+    return g->items[it].dot;
+}
+
+/* Get the symbol after the dot of an LR(0) item or XG_EPSILON if the
+   dot is at the end.  */
+static inline xg_sym
+xg_lr0item_sym(const xg_grammar *g, xg_lr0item it) {
+    return g->items[it].sym;
+}
 
 /* A transition in the LR(0) DFA.  */
 struct xg_lr0trans {
@@ -54,18 +71,35 @@ struct xg_lr0trans {
 };
 typedef struct xg_lr0trans xg_lr0trans;
 
+/* An entry in the index of the transitions of an LR(0) state.  */
+struct xg_lr0trans_ent {
+    /* Transition symbol.  */
+    xg_sym sym;
+
+    /* Transition number.  */
+    unsigned int id;
+};
+typedef struct xg_lr0trans_ent xg_lr0trans_ent;
+
 /* A reduction in the LR(0) DFA.  */
 struct xg_lr0reduct {
     /* Production number.  */
     unsigned int prod;
 
-    /* Lookahead set.  */
-    ulib_bitset la;
+    /* Lookahead set, shared with the other reductions with the same
+       lookaheads.  */
+    const xg_laset *la;
 };
 typedef struct xg_lr0reduct xg_lr0reduct;
 
 /* A state in the LR(0) DFA for viable prefixes.  */
 struct xg_lr0state {
+    /* Linked list for the DFA states hash table.  */
+    ulib_list list;
+
+    /* Hash value of the kernel items.  */
+    unsigned int hash;
+
     /* State id.  */
     unsigned int id;
 
@@ -75,12 +109,19 @@ struct xg_lr0state {
     /* Accepting state flag.  */
     unsigned int accept : 1;
 
-    /* LR(0) items.  */
+    /* LR(0) items.  The kernel items come first, followed by the
+       closure items, each sorted in ascending order.  */
     ulib_vector items;
 
+    /* Number of kernel items.  */
+    unsigned int kernel;
+
     /* Transitions.  */
     ulib_vector tr;
 
+    /* Index of the transitions, sorted by symbol.  */
+    ulib_vector trsym;
+
     /* Reductions.  */
     ulib_vector rd;
 };
@@ -89,10 +130,10 @@ typedef struct xg_lr0state xg_lr0state;
 /* Create an LR(0) DFA state.  */
 xg_lr0state *xg_lr0state_new();
 
-/* Add the item <PROD,DOT> to the state, if not already present.
-   Return negative on error, positive if the state changed (item not
-   present) or zero otherwise.  */
-int xg_lr0state_add_item(xg_lr0state *set, unsigned int prod, unsigned int dot);
+/* Add the item IT to the state, if not already present.  Return
+   negative on error, positive if the state changed (item not present)
+   or zero otherwise.  */
+int xg_lr0state_add_item(xg_lr0state *set, xg_lr0item it);
 
 /* Return the number of LR(0) items in the state.  */
 unsigned int xg_lr0state_item_count(const xg_lr0state *state);
@@ -108,9 +149,6 @@ xg_lr0item *xg_lr0state_items_front(const xg_lr0state *state);
    possibly invalidated after adding an item to the set.  */
 xg_lr0item *xg_lr0state_items_back(const xg_lr0state *state);
 
-/* Add a transition to an LR(0) state.  */
-int xg_lr0state_add_trans(xg_lr0state *state, unsigned int id);
-
 /* Remove a transition from an LR(0) state.  */
 void xg_lr0state_del_trans(xg_lr0state *state, unsigned int idx);
 
@@ -120,6 +158,10 @@ unsigned int xg_lr0state_trans_count(const xg_lr0state *state);
 /* Get the Nth transition ID.  */
 unsigned int xg_lr0state_get_trans(const xg_lr0state *state, unsigned int n);
 
+/* Find the transition on the symbol SYM from an LR(0) state.  Return
+   the transition ID or negative if not found.  */
+int xg_lr0state_find_trans(const xg_lr0state *state, xg_sym sym);
+
 /* Add a reduction to an LR(0) state.  If a reduction on PROD already
    exists, return a pointer to the existing reduction, otherwise
    create a new one.  Return null on error.  */
@@ -134,31 +176,46 @@ unsigned int xg_lr0state_reduct_count(const xg_lr0state *state);
 /* Get the Nth reduction.  */
 xg_lr0reduct *xg_lr0state_get_reduct(const xg_lr0state *state, unsigned int n);
 
-/* Compute the closure of an LR(0) state.  */
+/* Compute the closure of an LR(0) state.  The closure sets of the
+   non-terminals are a prerequisite for calling this function.  */
 int xg_lr0state_closure(const xg_grammar *g, xg_lr0state *state);
 
-/* Compute the goto (STATE, SYM) function.  */
-xg_lr0state *xg_lr0state_goto(const xg_grammar *g, const xg_lr0state *src, xg_sym sym);
-
-/* Display a debugging dump of an LR(0) state.  */
+/* Display a debugging dump of an LR(0) state.  If the DFA keeps only
+   kernel items, the closure of the state is computed in SCRATCH, or
+   only the kernel is shown if SCRATCH is null.  */
 struct xg_lr0dfa;
 void xg_lr0state_debug(FILE *out,
                        const xg_grammar *g,
                        const struct xg_lr0dfa *dfa,
-                       const xg_lr0state *state);
+                       const xg_lr0state *state,
+                       xg_lr0state *scratch);
+
+/* Number of LR(0) DFA index shards.  */
+#define XG_LR0DFA_INDEX_SHARDS 32
 
 /* LR(0) DFA.  */
 struct xg_lr0dfa {
     /* Automaton states (pointers).  */
     ulib_vector states;
 
+    /* Automaton states, hashed by their kernel items.  The index is
+       split into shards, which can be accessed concurrently.  */
+    ulib_hash index[XG_LR0DFA_INDEX_SHARDS];
+
     /* Automaton transitions.  */
     ulib_vector trans;
+
+    /* States keep only their kernel items.  */
+    unsigned int kernel_only : 1;
 };
 typedef struct xg_lr0dfa xg_lr0dfa;
 
-/* Create an LR(0) DFA.  */
-xg_lr0dfa *xg_lr0dfa_new(const xg_grammar *g);
+/* Create an LR(0) DFA.  If KERNEL_ONLY is non-zero, the states keep
+   only their kernel items and the closure is computed on demand.  The
+   states are constructed by NJOBS threads, the result does not depend
+   on their number.  The closure sets of the non-terminals are a
+   prerequisite for calling this function.  */
+xg_lr0dfa *xg_lr0dfa_new(const xg_grammar *g, int kernel_only, unsigned int njobs);
 
 /* Delete an LR(0) DFA.  */
 void xg_lr0dfa_del(xg_lr0dfa *dfa);
@@ -174,6 +231,15 @@ unsigned int xg_lr0dfa_state_count(const xg_lr0dfa *dfa);
 /* Get the N-th  LR(0) DFA state.  */
 xg_lr0state *xg_lr0dfa_get_state(const xg_lr0dfa *dfa, unsigned int n);
 
+/* Return a state, containing all the LR(0) items of STATE.  If the
+   DFA keeps only kernel items, the closure is computed in SCRATCH and
+   SCRATCH is returned, otherwise STATE itself is returned.  Return
+   null on error.  */
+const xg_lr0state *xg_lr0dfa_state_closure(const xg_grammar *g,
+                                           const xg_lr0dfa *dfa,
+                                           const xg_lr0state *state,
+                                           xg_lr0state *scratch);
+
 /* Add a transition from SRC to DST on symbol SYM to the LR (0)
    DFA.  */
 int xg_lr0dfa_add_trans(xg_lr0dfa *dfa, xg_sym sym, unsigned int src, unsigned int dst);
@@ -184,6 +250,18 @@ unsigned int xg_lr0dfa_trans_count(const xg_lr0dfa *dfa);
 /* Get the N-th  LR(0) DFA transition.  */
 xg_lr0trans *xg_lr0dfa_get_trans(const xg_lr0dfa *dfa, unsigned int n);
 
+/* Find the transition on the symbol SYM from the state S.  Return null
+   if not found.  */
+xg_lr0trans *xg_lr0dfa_find_trans(const xg_lr0dfa *dfa,
+                                  const xg_lr0state *s,
+                                  xg_sym sym);
+
+/* Compute the LR(0) closure set of each non-terminal.  */
+int xg_grammar_compute_lr0_closure(const xg_grammar *g);
+
+/* Release the LR(0) closure sets of the non-terminals.  */
+void xg_grammar_release_lr0_closure(const xg_grammar *g);
+
 /* Create reductions for an SLR(1) parser.  */
 int xg_make_slr_reductions(const xg_grammar *g, xg_lr0dfa *dfa);
 
@@ -19,38 +19,167 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.  
  */
 #include "xg.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Header of a memory block: its size and tag, padded to keep the data
+   aligned.  */
+union mem_header {
+    struct {
+        size_t size;
+        enum xg_mem_tag tag;
+    } h;
+    max_align_t align;
+};
+typedef union mem_header mem_header;
+
+/* Live bytes, peak live bytes and number of allocations of each tag
+   and, at XG_MEM_TAG_COUNT, of all of them.  Blocks are allocated and
+   released by several threads.  */
+static atomic_size_t mem_live[xg_mem_tag_count + 1];
+static atomic_size_t mem_peak[xg_mem_tag_count + 1];
+static atomic_ulong mem_count[xg_mem_tag_count + 1];
+
+/* Tag names.  */
+static const char *const mem_tag_name[xg_mem_tag_count] = {
+    [xg_mem_misc] = "misc",
+    [xg_mem_parse] = "parse",
+    [xg_mem_grammar] = "grammar",
+    [xg_mem_symdef] = "symdef",
+    [xg_mem_prod] = "prod",
+    [xg_mem_sets] = "sets",
+    [xg_mem_lr0state] = "lr0state",
+    [xg_mem_lr0dfa] = "lr0dfa",
+    [xg_mem_laset] = "laset",
+    [xg_mem_lalr] = "lalr",
+    [xg_mem_relation] = "relation",
+    [xg_mem_output] = "output",
+};
+
+/* Add SZ bytes to the live bytes of the counter N and update its
+   peak.  */
+static void
+mem_add(unsigned int n, size_t sz) {
+    size_t live, peak;
+
+    live = atomic_fetch_add_explicit(&mem_live[n], sz, memory_order_relaxed) + sz;
+    peak = atomic_load_explicit(&mem_peak[n], memory_order_relaxed);
+    while (live > peak
+           && !atomic_compare_exchange_weak_explicit(
+               &mem_peak[n], &peak, live, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/* Account a block of SZ bytes of TAG as allocated.  */
+static void
+mem_alloc(enum xg_mem_tag tag, size_t sz) {
+    mem_add(tag, sz);
+    mem_add(xg_mem_tag_count, sz);
+    atomic_fetch_add_explicit(&mem_count[tag], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&mem_count[xg_mem_tag_count], 1, memory_order_relaxed);
+}
+
+/* Account a block of SZ bytes of TAG as released.  */
+static void
+mem_release(enum xg_mem_tag tag, size_t sz) {
+    atomic_fetch_sub_explicit(&mem_live[tag], sz, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&mem_live[xg_mem_tag_count], sz, memory_order_relaxed);
+}
+
+/* Set up the header of the block at PTR and return the data.  */
+static void *
+mem_block(mem_header *ptr, enum xg_mem_tag tag, size_t sz) {
+    ptr->h.size = sz;
+    ptr->h.tag = tag;
+    mem_alloc(tag, sz);
+    return ptr + 1;
+}
 
 void *
-xg_malloc(size_t sz) {
-    void *ptr;
+xg_malloc(enum xg_mem_tag tag, size_t sz) {
+    mem_header *ptr;
 
-    ptr = malloc(sz);
-    if (ptr == 0 && sz != 0)
-        ulib_log_printf(
-            xg_log, "ERROR: Out of memory allocating %lu bytes", (unsigned long)sz);
-    return ptr;
+    if ((ptr = malloc(sizeof(mem_header) + sz)) == 0) {
+        xg_log_printf("ERROR: Out of memory allocating %lu bytes", (unsigned long)sz);
+        return 0;
+    }
+    return mem_block(ptr, tag, sz);
 }
 
 void *
-xg_calloc(size_t n, size_t sz) {
-    void *ptr;
+xg_calloc(enum xg_mem_tag tag, size_t n, size_t sz) {
+    mem_header *ptr;
+
+    if (sz != 0 && n > ((size_t)-1 - sizeof(mem_header)) / sz) {
+        xg_log_printf("ERROR: Out of memory allocating %lu elements", (unsigned long)n);
+        return 0;
+    }
 
-    ptr = calloc(n, sz);
-    if (ptr == 0 && n * sz != 0)
-        ulib_log_printf(
-            xg_log, "ERROR: Out of memory allocating %lu bytes", (unsigned long)n * sz);
-    return ptr;
+    if ((ptr = calloc(1, sizeof(mem_header) + n * sz)) == 0) {
+        xg_log_printf("ERROR: Out of memory allocating %lu bytes", (unsigned long)n * sz);
+        return 0;
+    }
+    return mem_block(ptr, tag, n * sz);
 }
 
 void *
-xg_realloc(void *oldptr, size_t sz) {
-    void *ptr;
-
-    ptr = realloc(oldptr, sz);
-    if (ptr == 0 && sz != 0)
-        ulib_log_printf(
-            xg_log, "ERROR: Out of memory allocating %lu bytes", (unsigned long)sz);
-    return ptr;
+xg_realloc(enum xg_mem_tag tag, void *oldptr, size_t sz) {
+    mem_header *ptr, *old;
+    size_t oldsz;
+
+    if (oldptr == 0)
+        return xg_malloc(tag, sz);
+
+    old = (mem_header *)oldptr - 1;
+    oldsz = old->h.size;
+    if ((ptr = realloc(old, sizeof(mem_header) + sz)) == 0) {
+        xg_log_printf("ERROR: Out of memory allocating %lu bytes", (unsigned long)sz);
+        return 0;
+    }
+    mem_release(ptr->h.tag, oldsz);
+    atomic_fetch_sub_explicit(&mem_count[ptr->h.tag], 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&mem_count[xg_mem_tag_count], 1, memory_order_relaxed);
+    return mem_block(ptr, tag, sz);
+}
+
+void
+xg_free(void *ptr) {
+    mem_header *hdr;
+
+    if (ptr == 0)
+        return;
+
+    hdr = (mem_header *)ptr - 1;
+    mem_release(hdr->h.tag, hdr->h.size);
+    free(hdr);
+}
+
+/* Account SZ bytes of an object, allocated outside of XG_MALLOC, as
+   allocated (SZ > 0) or released (SZ < 0).  */
+void
+xg_mem_account(enum xg_mem_tag tag, long sz) {
+    if (sz >= 0)
+        mem_alloc(tag, sz);
+    else
+        mem_release(tag, -sz);
+}
+
+/* Get the memory usage of TAG or, if TAG is XG_MEM_TAG_COUNT, of all
+   the tags together.  */
+xg_mem_usage
+xg_mem_get_usage(enum xg_mem_tag tag) {
+    xg_mem_usage u;
+
+    u.live = atomic_load_explicit(&mem_live[tag], memory_order_relaxed);
+    u.peak = atomic_load_explicit(&mem_peak[tag], memory_order_relaxed);
+    u.count = atomic_load_explicit(&mem_count[tag], memory_order_relaxed);
+    return u;
+}
+
+/* Get the name of TAG.  */
+const char *
+xg_mem_tag_name(enum xg_mem_tag tag) {
+    return tag < xg_mem_tag_count ? mem_tag_name[tag] : "total";
 }
 
 /*
@@ -154,7 +154,7 @@ scan_word(parse_ctx *ctx, int ch) {
     while (ch != EOF && !isspace(ch)) {
         if (cnt + 1 >= n) {
             n += 10;
-            word = xg_realloc(word, n);
+            word = xg_realloc(xg_mem_parse, word, n);
         }
         word[cnt++] = ch;
         ch = getc(ctx->in);
@@ -179,7 +179,7 @@ check_valid_word(parse_ctx *ctx) {
     }
 
     errorv(ctx, "Invalid token ``%s''", ctx->value.word);
-    free(ctx->value.word);
+    xg_free(ctx->value.word);
     return -1;
 }
 
@@ -201,7 +201,7 @@ recognize_keyword(parse_ctx *ctx) {
 
     for (p = kw; p->name; ++p) {
         if (strcmp(ctx->value.word, p->name) == 0) {
-            free(ctx->value.word);
+            xg_free(ctx->value.word);
             ctx->token = p->token;
             return 0;
         }
@@ -679,6 +679,10 @@ xg_grammar_read(const char *name) {
     /* Set precedence and associativity of productions.  */
     finish_productions(ctx.gram);
 
+    /* Number the LR(0) items and the terminals.  */
+    if (xg_grammar_number_items(ctx.gram) < 0 || xg_grammar_number_terminals(ctx.gram) < 0)
+        goto error;
+
     return ctx.gram;
 
 error:
@@ -0,0 +1,216 @@
+/* pool.c - Worker threads pool.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "pool.h"
+#include "xg.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* Number of elements, claimed at once by a thread.  Runs with no more
+   elements than this are done by the calling thread alone.  */
+#define XG_POOL_CHUNK 8
+
+/* Per-thread context.  */
+struct xg_pool_thread {
+    xg_pool *pool;
+    unsigned int id;
+    pthread_t thread;
+};
+typedef struct xg_pool_thread xg_pool_thread;
+
+struct xg_pool {
+    /* Threads, the first one is the calling thread.  */
+    unsigned int nthreads;
+    xg_pool_thread *threads;
+
+    /* Current run: function, its argument and the number of
+       elements.  */
+    xg_pool_func fn;
+    void *arg;
+    unsigned int n;
+
+    /* Next unclaimed element.  */
+    atomic_uint next;
+
+    /* Error flag of the current run.  */
+    atomic_int failed;
+
+    /* Run generation, number of threads still working on the current
+       run and termination flag, protected by LOCK.  */
+    unsigned int gen;
+    unsigned int active;
+    int quit;
+    pthread_mutex_t lock;
+
+    /* Signalled at the start and at the end of a run.  */
+    pthread_cond_t start;
+    pthread_cond_t finish;
+};
+
+/* Apply the function of the current run to the elements, claiming
+   them in chunks.  */
+static void
+pool_work(xg_pool *pool, unsigned int id) {
+    unsigned int i, end;
+
+    while (!atomic_load(&pool->failed)
+           && (i = atomic_fetch_add(&pool->next, XG_POOL_CHUNK)) < pool->n) {
+        end = i + XG_POOL_CHUNK < pool->n ? i + XG_POOL_CHUNK : pool->n;
+        for (; i < end; ++i) {
+            if (pool->fn(pool->arg, id, i) < 0) {
+                atomic_store(&pool->failed, 1);
+                break;
+            }
+        }
+    }
+}
+
+/* Pool thread main function.  */
+static void *
+pool_main(void *arg) {
+    unsigned int gen = 0;
+    xg_pool_thread *t = arg;
+    xg_pool *pool = t->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->gen == gen && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+            break;
+        gen = pool->gen;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_work(pool, t->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0)
+            pthread_cond_signal(&pool->finish);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+/* Create a pool of NTHREADS threads, including the calling one.  If a
+   thread cannot be started, the pool has fewer threads.  */
+xg_pool *
+xg_pool_new(unsigned int nthreads) {
+    xg_pool *pool;
+    xg_pool_thread *t;
+
+    if (nthreads == 0)
+        nthreads = 1;
+
+    if ((pool = xg_malloc(xg_mem_misc, sizeof(xg_pool))) == 0)
+        return 0;
+
+    if ((pool->threads = xg_calloc(xg_mem_misc, nthreads, sizeof(xg_pool_thread))) == 0) {
+        xg_free(pool);
+        return 0;
+    }
+
+    pool->fn = 0;
+    pool->arg = 0;
+    pool->n = 0;
+    atomic_init(&pool->next, 0);
+    atomic_init(&pool->failed, 0);
+    pool->gen = 0;
+    pool->active = 0;
+    pool->quit = 0;
+    pthread_mutex_init(&pool->lock, 0);
+    pthread_cond_init(&pool->start, 0);
+    pthread_cond_init(&pool->finish, 0);
+
+    pool->threads[0].pool = pool;
+    pool->threads[0].id = 0;
+    for (pool->nthreads = 1; pool->nthreads < nthreads; ++pool->nthreads) {
+        t = &pool->threads[pool->nthreads];
+        t->pool = pool;
+        t->id = pool->nthreads;
+        if (pthread_create(&t->thread, 0, pool_main, t) != 0)
+            break;
+    }
+
+    return pool;
+}
+
+/* Stop the threads and delete the pool.  */
+void
+xg_pool_del(xg_pool *pool) {
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 1; i < pool->nthreads; ++i)
+        pthread_join(pool->threads[i].thread, 0);
+
+    pthread_cond_destroy(&pool->finish);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    xg_free(pool->threads);
+    xg_free(pool);
+}
+
+/* Get the number of threads in the pool, including the calling one.  */
+unsigned int
+xg_pool_size(const xg_pool *pool) {
+    return pool->nthreads;
+}
+
+/* Apply FN to each of the numbers 0, 1, ..., N - 1 and wait for all of
+   them to complete.  Return negative if any of the calls failed.  */
+int
+xg_pool_run(xg_pool *pool, unsigned int n, xg_pool_func fn, void *arg) {
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->n = n;
+    atomic_store(&pool->next, 0);
+    atomic_store(&pool->failed, 0);
+
+    if (pool->nthreads > 1 && n > XG_POOL_CHUNK) {
+        pthread_mutex_lock(&pool->lock);
+        ++pool->gen;
+        pool->active = pool->nthreads - 1;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_work(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->active != 0)
+            pthread_cond_wait(&pool->finish, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    } else
+        pool_work(pool, 0);
+
+    return atomic_load(&pool->failed) ? -1 : 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,62 @@
+/* pool.h - Worker threads pool declarations.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef xg__pool_h
+#define xg__pool_h 1
+
+#include <ulib/defs.h>
+
+BEGIN_DECLS
+
+/* A pool of threads, which apply a function to each element of a range
+   of numbers.  The calling thread takes part in the work as the
+   thread number zero.  */
+typedef struct xg_pool xg_pool;
+
+/* Function, applied by the thread number THREAD to the element number
+   N.  Return negative on error.  */
+typedef int (*xg_pool_func)(void *arg, unsigned int thread, unsigned int n);
+
+/* Create a pool of NTHREADS threads, including the calling one.  If a
+   thread cannot be started, the pool has fewer threads.  */
+xg_pool *xg_pool_new(unsigned int nthreads);
+
+/* Stop the threads and delete the pool.  */
+void xg_pool_del(xg_pool *pool);
+
+/* Get the number of threads in the pool, including the calling one.  */
+unsigned int xg_pool_size(const xg_pool *pool);
+
+/* Apply FN to each of the numbers 0, 1, ..., N - 1 and wait for all of
+   them to complete.  The order of the calls is unspecified.  Return
+   negative if any of the calls failed.  */
+int xg_pool_run(xg_pool *pool, unsigned int n, xg_pool_func fn, void *arg);
+
+END_DECLS
+
+#endif /* xg__pool_h */
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
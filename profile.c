@@ -0,0 +1,287 @@
+/* profile.c - Parser visit profiles.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "profile.h"
+#include "xg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* Maximum length of a profile line.  */
+#define PROFILE_LINE_MAX 256
+
+/* Initial size of the case counts array.  */
+#define PROFILE_CASES_INITIAL 64
+
+/* Append the count CNT of the case of the state STATE on the token
+   TOKEN to the profile PROF.  Return negative on error.  */
+static int
+add_case(xg_profile *prof,
+         unsigned int *alloc,
+         unsigned int state,
+         int token,
+         unsigned long cnt) {
+    xg_profile_case *cases;
+    unsigned int n;
+
+    if (prof->ncases == *alloc) {
+        n = *alloc ? *alloc * 2 : PROFILE_CASES_INITIAL;
+        if ((cases = xg_realloc(xg_mem_misc, prof->cases, n * sizeof(*cases))) == 0)
+            return -1;
+        prof->cases = cases;
+        *alloc = n;
+    }
+
+    prof->cases[prof->ncases].state = state;
+    prof->cases[prof->ncases].token = token;
+    prof->cases[prof->ncases].count = cnt;
+    ++prof->ncases;
+
+    return 0;
+}
+
+/* Order case counts by state and token.  */
+static int
+case_cmp(const void *pa, const void *pb) {
+    const xg_profile_case *a = pa, *b = pb;
+
+    if (a->state != b->state)
+        return a->state < b->state ? -1 : 1;
+    return a->token < b->token ? -1 : a->token > b->token;
+}
+
+/* Sort the case counts of the profile PROF and add up the repeated
+   ones.  */
+static void
+merge_cases(xg_profile *prof) {
+    unsigned int i, n;
+
+    if (prof->ncases == 0)
+        return;
+
+    qsort(prof->cases, prof->ncases, sizeof(xg_profile_case), case_cmp);
+    for (i = 1, n = 0; i < prof->ncases; ++i) {
+        if (case_cmp(&prof->cases[i], &prof->cases[n]) == 0)
+            prof->cases[n].count += prof->cases[i].count;
+        else
+            prof->cases[++n] = prof->cases[i];
+    }
+    prof->ncases = n + 1;
+}
+
+/* Read the profile from the file NAME.  The profile must be for a
+   parser with NSTATES states and NPRODS productions.  Return null on
+   error.  */
+xg_profile *
+xg_profile_read(const char *name, unsigned int nstates, unsigned int nprods) {
+    FILE *in;
+    xg_profile *prof;
+    char line[PROFILE_LINE_MAX], word[16], *end;
+    unsigned int lineno, version, ns, np, n, alloc;
+    unsigned long cnt;
+    long token;
+
+    if ((in = fopen(name, "r")) == 0) {
+        ulib_log_printf(xg_log, "ERROR: Unable to open the profile ``%s''", name);
+        return 0;
+    }
+
+    if ((prof = xg_calloc(xg_mem_misc, 1, sizeof(xg_profile))) == 0)
+        goto error;
+
+    if (fgets(line, sizeof(line), in) == 0
+        || sscanf(line, "xg-profile %u %u %u", &version, &ns, &np) != 3 || version != 1) {
+        ulib_log_printf(xg_log, "ERROR: ``%s'' is not a parser profile", name);
+        goto error;
+    }
+
+    if (ns != nstates || np != nprods) {
+        ulib_log_printf(
+            xg_log, "ERROR: The profile ``%s'' is for a different parser", name);
+        goto error;
+    }
+
+    prof->nstates = nstates;
+    prof->nprods = nprods;
+    if ((prof->state = xg_calloc(xg_mem_misc, nstates, sizeof(unsigned long))) == 0
+        || (prof->prod = xg_calloc(xg_mem_misc, nprods, sizeof(unsigned long))) == 0)
+        goto error;
+
+    lineno = 1;
+    alloc = 0;
+    while (fgets(line, sizeof(line), in) != 0) {
+        ++lineno;
+        if (sscanf(line, "%15s", word) != 1)
+            continue;
+
+        if (strcmp(word, "state") == 0) {
+            if (sscanf(line, "%*s %u %lu", &n, &cnt) != 2 || n >= nstates)
+                goto invalid;
+            prof->state[n] += cnt;
+        } else if (strcmp(word, "prod") == 0) {
+            if (sscanf(line, "%*s %u %lu", &n, &cnt) != 2 || n >= nprods)
+                goto invalid;
+            prof->prod[n] += cnt;
+        } else if (strcmp(word, "case") == 0) {
+            if (sscanf(line, "%*s %u %15s %lu", &n, word, &cnt) != 3 || n >= nstates)
+                goto invalid;
+            if (strcmp(word, "default") == 0)
+                token = -1;
+            else if ((token = strtol(word, &end, 10)) < 0 || token > INT_MAX || *end != 0)
+                goto invalid;
+            if (add_case(prof, &alloc, n, token, cnt) < 0)
+                goto error;
+        }
+    }
+
+    merge_cases(prof);
+    fclose(in);
+    return prof;
+
+invalid:
+    ulib_log_printf(xg_log, "ERROR: %s:%u: Invalid profile line", name, lineno);
+error:
+    fclose(in);
+    xg_profile_del(prof);
+    return 0;
+}
+
+/* Delete a profile.  */
+void
+xg_profile_del(xg_profile *prof) {
+    if (prof) {
+        xg_free(prof->state);
+        xg_free(prof->prod);
+        xg_free(prof->cases);
+        xg_free(prof);
+    }
+}
+
+/* Get the number of times the state STATE took the action on the
+   token TOKEN, or the default action if TOKEN is negative.  */
+unsigned long
+xg_profile_case_count(const xg_profile *prof, unsigned int state, int token) {
+    xg_profile_case key;
+    const xg_profile_case *c;
+
+    if (prof->ncases == 0)
+        return 0;
+
+    key.state = state;
+    key.token = token;
+    c = bsearch(&key, prof->cases, prof->ncases, sizeof(xg_profile_case), case_cmp);
+
+    return c ? c->count : 0;
+}
+
+/* A number and its count.  */
+struct number_count {
+    unsigned long count;
+    unsigned int number;
+};
+
+/* Order numbers by decreasing count, then by increasing number.  */
+static int
+number_count_cmp(const void *pa, const void *pb) {
+    const struct number_count *a = pa, *b = pb;
+
+    if (a->count != b->count)
+        return a->count > b->count ? -1 : 1;
+    return a->number < b->number ? -1 : a->number > b->number;
+}
+
+/* Order the numbers from zero to N - 1 by decreasing COUNT, then by
+   increasing number, into ORDER.  Return negative on error.  */
+int
+xg_profile_order(const unsigned long *count, unsigned int n, unsigned int *order) {
+    unsigned int i;
+    struct number_count *nc;
+
+    if (n == 0)
+        return 0;
+
+    if ((nc = xg_malloc(xg_mem_misc, n * sizeof(*nc))) == 0)
+        return -1;
+
+    for (i = 0; i < n; ++i) {
+        nc[i].count = count[i];
+        nc[i].number = i;
+    }
+    qsort(nc, n, sizeof(*nc), number_count_cmp);
+    for (i = 0; i < n; ++i)
+        order[i] = nc[i].number;
+
+    xg_free(nc);
+    return 0;
+}
+
+/* Get the set of hot states: the most frequently visited ones, which
+   together account for at least COVERAGE percent of all the state
+   visits, and the initial state.  Set HOT[N] to one for each hot
+   state N and to zero for the others.  Return the number of hot
+   states or negative on error.  */
+int
+xg_profile_hot_states(const xg_profile *prof, unsigned int coverage, unsigned char *hot) {
+    unsigned int i, s, *order;
+    int n;
+    unsigned long long total, sum;
+
+    memset(hot, 0, prof->nstates);
+
+    total = 0;
+    for (i = 0; i < prof->nstates; ++i)
+        total += prof->state[i];
+
+    n = 0;
+    if (total != 0) {
+        if ((order = xg_malloc(xg_mem_misc, prof->nstates * sizeof(*order))) == 0
+            || xg_profile_order(prof->state, prof->nstates, order) < 0) {
+            xg_free(order);
+            return -1;
+        }
+
+        sum = 0;
+        for (i = 0; i < prof->nstates; ++i) {
+            s = order[i];
+            if (prof->state[s] == 0 || sum * 100 >= total * coverage)
+                break;
+            hot[s] = 1;
+            sum += prof->state[s];
+            ++n;
+        }
+        xg_free(order);
+    }
+
+    if (prof->nstates != 0 && !hot[0]) {
+        hot[0] = 1;
+        ++n;
+    }
+
+    return n;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,117 @@
+/* profile.h - Parser visit profiles.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef xg__profile_h
+#define xg__profile_h 1
+
+#include <ulib/defs.h>
+
+BEGIN_DECLS
+
+/* A profile is a text file, which starts with the line
+
+     xg-profile 1 <states> <prods>
+
+   giving the number of the states and the productions of the parser,
+   followed by lines
+
+     state <n> <count>
+     prod <n> <count>
+
+   with the number of times the state N was entered and the production
+   N was reduced.  Missing counts are zero, repeated ones are added
+   up.  Lines, starting with other words, are ignored.  The profiles,
+   written by instrumented parsers, also contain lines
+
+     symbol <code> <count>
+     case <state> <token> <count>
+     case <state> default <count>
+     depth <n> <count>
+
+   with the number of transitions on the non-terminal CODE, the number
+   of times the state STATE took the action on TOKEN or the default
+   one, and the number of shifts at stack depths from 2^N to
+   2^(N+1) - 1.  */
+
+/* Count of a switch case: the number of times the state STATE took
+   the action on the token TOKEN, or the default action if TOKEN is
+   negative.  */
+struct xg_profile_case {
+    unsigned int state;
+    int token;
+    unsigned long count;
+};
+typedef struct xg_profile_case xg_profile_case;
+
+/* Visit counts of a parser.  */
+struct xg_profile {
+    /* Number of states and visits of each state.  */
+    unsigned int nstates;
+    unsigned long *state;
+
+    /* Number of productions and reductions by each production.  */
+    unsigned int nprods;
+    unsigned long *prod;
+
+    /* Number of the case counts and the counts, ordered by state and
+       token.  */
+    unsigned int ncases;
+    xg_profile_case *cases;
+};
+typedef struct xg_profile xg_profile;
+
+/* Read the profile from the file NAME.  The profile must be for a
+   parser with NSTATES states and NPRODS productions.  Return null on
+   error.  */
+xg_profile *xg_profile_read(const char *name, unsigned int nstates, unsigned int nprods);
+
+/* Delete a profile.  */
+void xg_profile_del(xg_profile *prof);
+
+/* Get the set of hot states: the most frequently visited ones, which
+   together account for at least COVERAGE percent of all the state
+   visits, and the initial state.  Set HOT[N] to one for each hot
+   state N and to zero for the others.  Return the number of hot
+   states or negative on error.  */
+int xg_profile_hot_states(const xg_profile *prof,
+                          unsigned int coverage,
+                          unsigned char *hot);
+
+/* Get the number of times the state STATE took the action on the
+   token TOKEN, or the default action if TOKEN is negative.  */
+unsigned long xg_profile_case_count(const xg_profile *prof,
+                                    unsigned int state,
+                                    int token);
+
+/* Order the numbers from zero to N - 1 by decreasing COUNT, then by
+   increasing number, into ORDER.  Return negative on error.  */
+int xg_profile_order(const unsigned long *count, unsigned int n, unsigned int *order);
+
+END_DECLS
+
+#endif /* xg__profile_h */
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
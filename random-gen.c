@@ -20,6 +20,7 @@
  */
 
 #include "grammar.h"
+#include "xg.h"
 #include <stdio.h>
 #include <time.h>
 #include <ulib/rand.h>
@@ -47,7 +48,7 @@ expand(ulib_vector *v, const xg_grammar *g, xg_sym s, unsigned int rec) {
     n = xg_symdef_prod_count(def);
 
     /* Generate a random order of possible derivations.  */
-    if ((order = malloc(n * sizeof(unsigned int))) == 0)
+    if ((order = xg_malloc(xg_mem_misc, n * sizeof(unsigned int))) == 0)
         return -1;
     for (r = 0; r < n; ++r)
         order[r] = r;
@@ -68,12 +69,12 @@ expand(ulib_vector *v, const xg_grammar *g, xg_sym s, unsigned int rec) {
         }
 
         if (plen == 0) {
-            free(order);
+            xg_free(order);
             return 0;
         }
     }
 
-    free(order);
+    xg_free(order);
     return -1;
 }
 
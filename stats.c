@@ -0,0 +1,184 @@
+/* stats.c - Generator statistics.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* For clock_gettime.  */
+#define _POSIX_C_SOURCE 200112L
+
+#include "stats.h"
+#include "xg.h"
+#include <time.h>
+
+/* Maximum number of recorded phases.  */
+#define STATS_MAX_PHASES 32
+
+unsigned long xg_stats[xg_stat_count] = {
+    [xg_stat_lasets] = XG_STAT_UNKNOWN,
+    [xg_stat_output_bytes] = XG_STAT_UNKNOWN,
+};
+
+/* Counter names.  */
+static const char *const stat_name[xg_stat_count] = {
+    [xg_stat_symbols] = "symbols",
+    [xg_stat_prods] = "productions",
+    [xg_stat_items] = "items",
+    [xg_stat_states] = "states",
+    [xg_stat_trans] = "transitions",
+    [xg_stat_edges] = "relation_edges",
+    [xg_stat_sccs] = "sccs",
+    [xg_stat_sr_conflicts] = "sr_conflicts",
+    [xg_stat_rr_conflicts] = "rr_conflicts",
+    [xg_stat_lasets] = "lookahead_sets",
+    [xg_stat_cases] = "cases",
+    [xg_stat_table_entries] = "table_entries",
+    [xg_stat_output_bytes] = "output_bytes",
+};
+
+/* Recorded phases.  */
+static struct {
+    const char *name;
+    xg_stats_time time;
+} phase[STATS_MAX_PHASES];
+static unsigned int nphases;
+
+/* Get the time of the clock CLK in seconds.  */
+static double
+clock_seconds(clockid_t clk) {
+    struct timespec ts;
+
+    if (clock_gettime(clk, &ts) < 0)
+        return 0.0;
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Get the current time.  */
+xg_stats_time
+xg_stats_now(void) {
+    xg_stats_time t;
+
+    t.wall = clock_seconds(CLOCK_MONOTONIC);
+    t.cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    return t;
+}
+
+/* Record the time, spent in the phase NAME since START.  NAME is not
+   copied.  */
+void
+xg_stats_phase(const char *name, xg_stats_time start) {
+    xg_stats_time now;
+
+    if (nphases == STATS_MAX_PHASES)
+        return;
+
+    now = xg_stats_now();
+    phase[nphases].name = name;
+    phase[nphases].time.wall = now.wall - start.wall;
+    phase[nphases].time.cpu = now.cpu - start.cpu;
+    ++nphases;
+}
+
+/* Output the statistics as a table.  */
+static void
+print_table(FILE *out) {
+    unsigned int i;
+    double wall = 0.0, cpu = 0.0;
+
+    fprintf(out, "%-16s %12s %12s\n", "phase", "wall (s)", "cpu (s)");
+    for (i = 0; i < nphases; ++i) {
+        fprintf(out, "%-16s %12.6f %12.6f\n", phase[i].name, phase[i].time.wall, phase[i].time.cpu);
+        wall += phase[i].time.wall;
+        cpu += phase[i].time.cpu;
+    }
+    fprintf(out, "%-16s %12.6f %12.6f\n\n", "total", wall, cpu);
+
+    fprintf(out, "%-16s %12s\n", "counter", "value");
+    for (i = 0; i < xg_stat_count; ++i) {
+        if (xg_stats[i] != XG_STAT_UNKNOWN)
+            fprintf(out, "%-16s %12lu\n", stat_name[i], xg_stats[i]);
+    }
+
+    fprintf(out, "\n%-16s %12s %12s %12s\n", "memory", "live", "peak", "allocs");
+    for (i = 0; i <= xg_mem_tag_count; ++i) {
+        xg_mem_usage u = xg_mem_get_usage(i);
+
+        if (i < xg_mem_tag_count && u.count == 0)
+            continue;
+        fprintf(out,
+                "%-16s %12lu %12lu %12lu\n",
+                i < xg_mem_tag_count ? xg_mem_tag_name(i) : "total",
+                (unsigned long)u.live,
+                (unsigned long)u.peak,
+                u.count);
+    }
+}
+
+/* Output the statistics as a JSON object.  */
+static void
+print_json(FILE *out) {
+    unsigned int i;
+    const char *sep;
+
+    fputs("{\n  \"phases\": [", out);
+    for (i = 0; i < nphases; ++i)
+        fprintf(out,
+                "%s\n    {\"name\": \"%s\", \"wall\": %.6f, \"cpu\": %.6f}",
+                i ? "," : "",
+                phase[i].name,
+                phase[i].time.wall,
+                phase[i].time.cpu);
+    fputs("\n  ],\n  \"counters\": {", out);
+    for (i = 0, sep = ""; i < xg_stat_count; ++i) {
+        if (xg_stats[i] != XG_STAT_UNKNOWN) {
+            fprintf(out, "%s\n    \"%s\": %lu", sep, stat_name[i], xg_stats[i]);
+            sep = ",";
+        }
+    }
+    fputs("\n  },\n  \"memory\": {", out);
+    for (i = 0; i <= xg_mem_tag_count; ++i) {
+        xg_mem_usage u = xg_mem_get_usage(i);
+
+        fprintf(out,
+                "%s\n    \"%s\": {\"live\": %lu, \"peak\": %lu, \"allocs\": %lu}",
+                i ? "," : "",
+                i < xg_mem_tag_count ? xg_mem_tag_name(i) : "total",
+                (unsigned long)u.live,
+                (unsigned long)u.peak,
+                u.count);
+    }
+    fputs("\n  }\n}\n", out);
+}
+
+/* Output the phase times, the counters and the memory usage to OUT in
+   FORMAT.  */
+void
+xg_stats_print(FILE *out, enum xg_stats_format format) {
+    if (format == xg_stats_json)
+        print_json(out);
+    else
+        print_table(out);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
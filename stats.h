@@ -0,0 +1,101 @@
+/* stats.h - Generator statistics declarations.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef xg__stats_h
+#define xg__stats_h 1
+
+#include <ulib/defs.h>
+#include <stdio.h>
+
+BEGIN_DECLS
+
+/* Statistics counters.  */
+enum xg_stat {
+    xg_stat_symbols,
+    xg_stat_prods,
+    xg_stat_items,
+    xg_stat_states,
+    xg_stat_trans,
+    xg_stat_edges,
+    xg_stat_sccs,
+    xg_stat_sr_conflicts,
+    xg_stat_rr_conflicts,
+    xg_stat_lasets,
+    xg_stat_cases,
+    xg_stat_table_entries,
+    xg_stat_output_bytes,
+    xg_stat_count
+};
+
+/* Value of a counter, which is not known.  Such counters are left out
+   of the statistics output.  The number of lookahead sets is known
+   only for SLR and LALR outputs, the size of the output only if the
+   output is a regular file.  */
+#define XG_STAT_UNKNOWN (~0UL)
+
+/* Counter values.  The counters are updated only by the main
+   thread.  */
+extern unsigned long xg_stats[xg_stat_count];
+
+/* Add N to the counter S.  */
+static inline void
+xg_stat_add(enum xg_stat s, unsigned long n) {
+    xg_stats[s] += n;
+}
+
+/* Set the counter S to N.  */
+static inline void
+xg_stat_set(enum xg_stat s, unsigned long n) {
+    xg_stats[s] = n;
+}
+
+/* Statistics output formats.  */
+enum xg_stats_format { xg_stats_table, xg_stats_json };
+
+/* A point in time, both by the wall clock and by the CPU time of the
+   process, in seconds.  */
+struct xg_stats_time {
+    double wall;
+    double cpu;
+};
+typedef struct xg_stats_time xg_stats_time;
+
+/* Get the current time.  */
+xg_stats_time xg_stats_now(void);
+
+/* Record the time, spent in the phase NAME since START.  NAME is not
+   copied.  */
+void xg_stats_phase(const char *name, xg_stats_time start);
+
+/* Output the phase times, the counters and the memory usage to OUT in
+   FORMAT.  */
+void xg_stats_print(FILE *out, enum xg_stats_format format);
+
+END_DECLS
+
+#endif /* xg__stats_h */
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,179 @@
+/* termset.h - Terminal sets.
+ *
+ * Copyright (C) 2006 Momchil Velikov
+ *
+ * This file is part of XG.
+ *
+ * XG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * XG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with XG; if not, write to the Free Software Foundation,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef xg__termset_h
+#define xg__termset_h 1
+
+#include <ulib/defs.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+BEGIN_DECLS
+
+/* A terminal set is a fixed-width array of words, indexed by the
+   terminal numbers of the grammar (see xg_grammar_number_terminals).
+   All the sets of a grammar have the same number of words.  The
+   operations below take the number of words as their last
+   argument.  */
+typedef uint64_t xg_termset_word;
+
+/* Number of bits in a terminal set word.  */
+#define XG_TERMSET_WORD_BITS 64
+
+/* Get the number of words in a set of N terminals.  */
+static inline unsigned int
+xg_termset_words(unsigned int n) {
+    return (n + XG_TERMSET_WORD_BITS - 1) / XG_TERMSET_WORD_BITS;
+}
+
+/* Check if the terminal T is in SET.  */
+static inline int
+xg_termset_is_set(const xg_termset_word *set, unsigned int t) {
+    return (set[t / XG_TERMSET_WORD_BITS] >> (t % XG_TERMSET_WORD_BITS)) & 1;
+}
+
+/* Add the terminal T to SET.  */
+static inline void
+xg_termset_set(xg_termset_word *set, unsigned int t) {
+    set[t / XG_TERMSET_WORD_BITS] |= (xg_termset_word)1 << (t % XG_TERMSET_WORD_BITS);
+}
+
+/* Remove the terminal T from SET.  */
+static inline void
+xg_termset_clear(xg_termset_word *set, unsigned int t) {
+    set[t / XG_TERMSET_WORD_BITS] &= ~((xg_termset_word)1 << (t % XG_TERMSET_WORD_BITS));
+}
+
+/* Copy SRC to DST.  */
+static inline void
+xg_termset_copy(xg_termset_word *dst, const xg_termset_word *src, unsigned int n) {
+    memcpy(dst, src, n * sizeof(xg_termset_word));
+}
+
+/* Set DST to the union of DST and SRC.  The sets may be the same.  */
+static inline void
+xg_termset_or(xg_termset_word *dst, const xg_termset_word *src, unsigned int n) {
+    unsigned int i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(dst + i)),
+                                            _mm256_loadu_si256((const __m256i *)(src + i))));
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_or_si128(_mm_loadu_si128((const __m128i *)(dst + i)),
+                                      _mm_loadu_si128((const __m128i *)(src + i))));
+#endif
+    for (; i < n; ++i)
+        dst[i] |= src[i];
+}
+
+/* Set DST to the union of DST and the elements of SRC, which are not in
+   MASK.  Return non-zero if DST changed.  */
+static inline int
+xg_termset_or_andn_chg(xg_termset_word *restrict dst,
+                       const xg_termset_word *restrict src,
+                       const xg_termset_word *restrict mask,
+                       unsigned int n) {
+    unsigned int i = 0;
+    xg_termset_word add, chg = 0;
+
+#if defined(__AVX2__)
+    __m256i a, b, acc = _mm256_setzero_si256();
+
+    for (; i + 4 <= n; i += 4) {
+        a = _mm256_loadu_si256((const __m256i *)(dst + i));
+        b = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *)(mask + i)),
+                                _mm256_loadu_si256((const __m256i *)(src + i)));
+        acc = _mm256_or_si256(acc, _mm256_andnot_si256(a, b));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(a, b));
+    }
+    chg = !_mm256_testz_si256(acc, acc);
+#elif defined(__SSE2__)
+    __m128i a, b, acc = _mm_setzero_si128();
+
+    for (; i + 2 <= n; i += 2) {
+        a = _mm_loadu_si128((const __m128i *)(dst + i));
+        b = _mm_andnot_si128(_mm_loadu_si128((const __m128i *)(mask + i)),
+                             _mm_loadu_si128((const __m128i *)(src + i)));
+        acc = _mm_or_si128(acc, _mm_andnot_si128(a, b));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(a, b));
+    }
+    chg = _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff;
+#endif
+    for (; i < n; ++i) {
+        add = src[i] & ~mask[i];
+        chg |= add & ~dst[i];
+        dst[i] |= add;
+    }
+
+    return chg != 0;
+}
+
+/* Get the number of elements of SET.  */
+static inline unsigned int
+xg_termset_count(const xg_termset_word *set, unsigned int n) {
+    unsigned int i, cnt = 0;
+
+    for (i = 0; i < n; ++i)
+        cnt += __builtin_popcountll(set[i]);
+
+    return cnt;
+}
+
+/* Get the number of the first element of SET, not less than T, or N *
+   XG_TERMSET_WORD_BITS if there is no such element.  */
+static inline unsigned int
+xg_termset_next(const xg_termset_word *set, unsigned int t, unsigned int n) {
+    unsigned int i = t / XG_TERMSET_WORD_BITS;
+    xg_termset_word w;
+
+    if (i >= n)
+        return n * XG_TERMSET_WORD_BITS;
+
+    w = set[i] & (~(xg_termset_word)0 << (t % XG_TERMSET_WORD_BITS));
+    while (w == 0) {
+        if (++i == n)
+            return n * XG_TERMSET_WORD_BITS;
+        w = set[i];
+    }
+
+    return i * XG_TERMSET_WORD_BITS + __builtin_ctzll(w);
+}
+
+END_DECLS
+
+#endif /* xg__termset_h */
+
+/*
+ * Local variables:
+ * mode: C
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -10,6 +10,31 @@
 #include <stdlib.h>
 #include <assert.h>
 
+/* Branch prediction hints.  */
+#if defined(__GNUC__)
+#define XG__LIKELY(X) __builtin_expect(!!(X), 1)
+#define XG__UNLIKELY(X) __builtin_expect(!!(X), 0)
+#else
+#define XG__LIKELY(X) (X)
+#define XG__UNLIKELY(X) (X)
+#endif
+
+/* Attribute of the labels of rarely executed code.  */
+#if defined(__GNUC__) && !defined(__clang__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#define XG__COLD __attribute__((cold))
+#else
+#define XG__COLD
+#endif
+
+/* Parsers, generated with computed gotos, jump to the destination of a
+   transition on a non-terminal through a table of label addresses, a
+   GNU C extension.  Defining XG_NO_COMPUTED_GOTO makes them use switch
+   statements instead.  */
+#if defined(__GNUC__) && !defined(XG_NO_COMPUTED_GOTO)
+#define XG__COMPUTED_GOTO 1
+#endif
+
 /* Parser stack entry.  */
 struct xg__stkent {
     /* DFA state.  */
@@ -70,7 +95,7 @@ xg__stack_grow(xg__stack *stk) {
 /* Ensure there's enough space in the stack for at least one push.  */
 static inline int
 xg__stack_ensure(xg__stack *stk) {
-    return (stk->top - stk->base < stk->alloc) ? 0 : xg__stack_grow(stk);
+    return XG__LIKELY(stk->top - stk->base < stk->alloc) ? 0 : xg__stack_grow(stk);
 }
 
 /* Push a state on the stack.  */
@@ -185,14 +210,14 @@ xg__stack_dump(const xg_parse_ctx *ctx, const xg__stack *stk) {
 
 #endif /* NDEBUG */
 
-#define XG__SHIFT                           \
-    do {                                    \
-        XG__TRACE_SHIFT(token);             \
-        xg__stack_top(&stk)->value = value; \
-        token = ctx->get_token(&value);     \
-        XG__TRACE_NEXT_TOKEN(token);        \
-        if (xg__stack_ensure(&stk) < 0)     \
-            goto internal_error;            \
+#define XG__SHIFT                                     \
+    do {                                              \
+        XG__TRACE_SHIFT(token);                       \
+        xg__stack_top(&stk)->value = value;           \
+        token = ctx->get_token(&value);               \
+        XG__TRACE_NEXT_TOKEN(token);                  \
+        if (XG__UNLIKELY(xg__stack_ensure(&stk) < 0)) \
+            goto internal_error;                      \
     } while (0)
 
 #define XG__PUSH(N)              \
@@ -210,7 +235,7 @@ xg__stack_dump(const xg_parse_ctx *ctx, const xg__stack *stk) {
         state = xg__stack_top(&stk)->state; \
     } while (0)
 
-#define XG__PARSER_FUNCTION_START              \
+#define XG__PARSER_FUNCTION_INIT               \
     /* Current token.  */                      \
     int token;                                 \
                                                \
@@ -227,8 +252,10 @@ xg__stack_dump(const xg_parse_ctx *ctx, const xg__stack *stk) {
         return -1;                             \
                                                \
     token = ctx->get_token(&value);            \
-    XG__TRACE_NEXT_TOKEN(token);               \
-                                               \
+    XG__TRACE_NEXT_TOKEN(token)
+
+#define XG__PARSER_FUNCTION_START \
+    XG__PARSER_FUNCTION_INIT;     \
     goto push_0
 
 #define XG__PARSER_FUNCTION_END(N) \
@@ -237,6 +264,156 @@ xg__stack_dump(const xg_parse_ctx *ctx, const xg__stack *stk) {
         return N;                  \
     } while (0)
 
+/* Write the visit counters of an instrumented parser to the profile
+   file NAME.  Return negative on error.  */
+int xg_parse_dump_profile(const char *name);
+
+#ifdef XG__INSTRUMENT
+#include <stdio.h>
+
+/* Instrumented parsers count the entries to each state, the reductions
+   by each production, the transitions on each non-terminal and the
+   tokens, taken by each case of the switch statements of the states.
+   Table driven parsers count instead the actions of each state on each
+   terminal.  All of them sample the stack depth at each shift.  */
+
+/* Number of buckets of the stack depth histogram.  The bucket N counts
+   the depths D, such that 2^N <= D < 2^(N+1).  */
+#define XG__DEPTH_BUCKETS 32
+
+/* Visit counters of an instrumented parser.  */
+struct xg__counters {
+    /* Number of states and entries to each state.  */
+    unsigned int nstates;
+    const unsigned long *state;
+
+    /* Number of productions and reductions by each production.  */
+    unsigned int nprods;
+    const unsigned long *prod;
+
+    /* Number of non-terminals, their symbol codes and the transitions
+       on each non-terminal.  */
+    unsigned int nnts;
+    const unsigned int *nt_symbol;
+    const unsigned long *symbol;
+
+    /* Number of cases, the state and the token (-1 for the default) of
+       each case and the number of times it was taken.  */
+    unsigned int ncases;
+    const unsigned int *case_state;
+    const int *case_token;
+    const unsigned long *cases;
+
+    /* In table driven parsers, the number of terminals, the token of
+       each terminal and the number of times each state took the action
+       on each terminal, NTERMS + 1 counts per state, the last one for
+       the tokens, which are not terminals.  */
+    unsigned int nterms;
+    const int *term_token;
+    const unsigned long *actions;
+
+    /* Stack depth histogram.  */
+    const unsigned long *depth;
+};
+typedef struct xg__counters xg__counters;
+
+/* Count an event.  */
+#define XG__COUNT(C) (++(C))
+
+/* Add the stack depth DEPTH to the histogram HIST.  */
+static inline void
+xg__sample_depth(unsigned long *hist, long depth) {
+    unsigned int n = 0;
+
+    while (depth > 1 && n < XG__DEPTH_BUCKETS - 1) {
+        depth >>= 1;
+        ++n;
+    }
+    ++hist[n];
+}
+
+#define XG__SAMPLE_DEPTH() xg__sample_depth(xg__count_depth, stk.top - stk.base)
+
+/* Write the counters CNT to the profile file NAME.  Only the non-zero
+   counts are written.  Return negative on error.  */
+static int
+xg__write_profile(const char *name, const xg__counters *cnt) {
+    FILE *out;
+    unsigned int i, s, t;
+
+    if ((out = fopen(name, "w")) == 0)
+        return -1;
+
+    fprintf(out, "xg-profile 1 %u %u\n", cnt->nstates, cnt->nprods);
+    for (i = 0; i < cnt->nstates; ++i)
+        if (cnt->state[i])
+            fprintf(out, "state %u %lu\n", i, cnt->state[i]);
+    for (i = 0; i < cnt->nprods; ++i)
+        if (cnt->prod[i])
+            fprintf(out, "prod %u %lu\n", i, cnt->prod[i]);
+    for (i = 0; i < cnt->nnts; ++i)
+        if (cnt->symbol[i])
+            fprintf(out, "symbol %u %lu\n", cnt->nt_symbol[i], cnt->symbol[i]);
+    for (i = 0; i < cnt->ncases; ++i)
+        if (cnt->cases[i]) {
+            if (cnt->case_token[i] < 0)
+                fprintf(out, "case %u default %lu\n", cnt->case_state[i], cnt->cases[i]);
+            else
+                fprintf(out,
+                        "case %u %d %lu\n",
+                        cnt->case_state[i],
+                        cnt->case_token[i],
+                        cnt->cases[i]);
+        }
+    for (i = 0; cnt->actions && i < cnt->nstates * (cnt->nterms + 1); ++i)
+        if (cnt->actions[i]) {
+            s = i / (cnt->nterms + 1);
+            t = i % (cnt->nterms + 1);
+            if (t == cnt->nterms)
+                fprintf(out, "case %u default %lu\n", s, cnt->actions[i]);
+            else
+                fprintf(out, "case %u %d %lu\n", s, cnt->term_token[t], cnt->actions[i]);
+        }
+    for (i = 0; i < XG__DEPTH_BUCKETS; ++i)
+        if (cnt->depth[i])
+            fprintf(out, "depth %u %lu\n", i, cnt->depth[i]);
+
+    if (ferror(out)) {
+        fclose(out);
+        return -1;
+    }
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+#endif /* XG__INSTRUMENT */
+
+/* Table driven parsers define the constants XG__NSTATES, XG__NPRODS,
+   XG__NTERMS and XG__MAX_TOKEN and the tables below.  The actions of
+   the states and the transitions on the non-terminals are looked up
+   in the comb vector XG__TABLE, at the offset of the row, and the
+   default is taken, unless XG__CHECK confirms the entry belongs to the
+   row.  */
+
+/* Terminal number of a token.  */
+#define XG__TERM(TOKEN) \
+    ((unsigned int)(TOKEN) <= XG__MAX_TOKEN ? xg__translate[TOKEN] : XG__NTERMS)
+
+/* Look up the column COL of the row ROW.  */
+#define XG__LOOKUP(BASE, DFLT, ROW, COL)                                   \
+    (xg__check[BASE[ROW] + (COL)] == (COL) ? xg__table[BASE[ROW] + (COL)] \
+                                           : DFLT[ROW])
+
+/* Parse action of the state STATE on the terminal TERM: a shift to a
+   state below XG__NSTATES, XG__ACCEPT, a reduction by the production
+   ACT - XG__NSTATES or XG__ERROR.  */
+#define XG__ACTION(STATE, TERM) XG__LOOKUP(xg__action_base, xg__defact, STATE, TERM)
+#define XG__ACCEPT XG__NSTATES
+#define XG__ERROR (XG__NSTATES + XG__NPRODS)
+
+/* Destination of the transition from the state STATE on the
+   non-terminal number NT.  */
+#define XG__GOTO(STATE, NT) XG__LOOKUP(xg__goto_base, xg__defgoto, NT, STATE)
+
 #endif /* xg__c_parser_h 1 */
 
 /*
@@ -21,16 +21,23 @@
 #include "grammar.h"
 #include "lr0.h"
 #include "lalr.h"
+#include "laset.h"
 #include "gen-parser.h"
+#include "stats.h"
 #include "xg.h"
 
 #include <ulib/cache.h>
 #include <ulib/options.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 
 /* XG message log.  */
 ulib_log *xg_log;
 
+/* Lock, serializing the access to the message log.  */
+pthread_mutex_t xg_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Instrument the parser for debugging info.  */
 int xg_flag_debug = 0;
 
@@ -49,16 +56,48 @@ int xg_sentence_size = 10;
 /* Output token codes, instead of token names.  */
 int xg_flag_token_codes = 0;
 
+/* Store only the kernel items of the LR(0) states.  */
+int xg_flag_kernel_only = 0;
+
+/* Number of threads, constructing the LR(0) DFA and the LALR(1)
+   lookahead sets.  */
+int xg_jobs = 1;
+
 /* Report file name.  */
 const char *xg_report = 0;
 
 /* Generate report.  */
 int xg_flag_report = 0;
 
+/* Output statistics.  */
+int xg_flag_stats = 0;
+
+/* Statistics format.  */
+enum xg_stats_format xg_stats_format = xg_stats_table;
+
 /* Output type.  */
 enum output_type { output_defines = 1, output_slr, output_lalr, output_random_sentence };
 int xg_flag_output_type = output_lalr;
 
+/* Parser backend: a directly executable parser or a table driven
+   one.  */
+enum backend { backend_direct, backend_tables };
+int xg_backend = backend_direct;
+
+/* Profile file name.  */
+const char *xg_profile_name = 0;
+
+/* Percentage of the profiled state visits, covered by the hot
+   states, or negative if not given.  */
+#define XG_HOT_COVERAGE_DEFAULT 99
+int xg_hot_coverage = -1;
+
+/* Instrument the parser with visit counters.  */
+int xg_flag_instrument = 0;
+
+/* Dispatch the transitions on non-terminals with computed gotos.  */
+int xg_flag_computed_goto = 0;
+
 static int
 print_version() {
     fputs("xg (XG) 0.1 (alpha)\n", stderr);
@@ -110,12 +149,103 @@ handle_sentence_size(const char *arg) {
     return 0;
 }
 
+static int
+handle_jobs(const char *arg) {
+    long n;
+    char *end;
+
+    n = strtol(arg, &end, 0);
+    if (*end != 0 || n < 1) {
+        fprintf(stderr, "xg: ERROR: invalid argument to --jobs\n");
+        return -1;
+    }
+    xg_jobs = n;
+    return 0;
+}
+
 static int
 handle_report(const char *arg) {
     xg_report = arg;
     return 0;
 }
 
+static int
+handle_stats(const char *arg) {
+    if (arg == 0 || strcmp(arg, "table") == 0)
+        xg_stats_format = xg_stats_table;
+    else if (strcmp(arg, "json") == 0)
+        xg_stats_format = xg_stats_json;
+    else {
+        fprintf(stderr, "xg: ERROR: invalid argument to --stats\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int
+handle_backend(const char *arg) {
+    if (strcmp(arg, "direct") == 0)
+        xg_backend = backend_direct;
+    else if (strcmp(arg, "tables") == 0)
+        xg_backend = backend_tables;
+    else {
+        fprintf(stderr, "xg: ERROR: invalid argument to --backend\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int
+handle_profile(const char *arg) {
+    xg_profile_name = arg;
+    return 0;
+}
+
+static int
+handle_hot_coverage(const char *arg) {
+    long n;
+    char *end;
+
+    n = strtol(arg, &end, 0);
+    if (*end != 0 || n < 0 || n > 100) {
+        fprintf(stderr, "xg: ERROR: invalid argument to --hot-coverage\n");
+        return -1;
+    }
+    xg_hot_coverage = n;
+    return 0;
+}
+
+/* Reject the options, which do not apply to the requested output.
+   Return negative on error.  */
+static int
+check_output_options() {
+    const char *opt;
+
+    /* Profiles and computed gotos are only for directly executable
+       parsers.  */
+    if (xg_backend != backend_direct
+        || (xg_flag_output_type != output_slr && xg_flag_output_type != output_lalr)) {
+        if (xg_profile_name)
+            opt = "--profile";
+        else if (xg_hot_coverage >= 0)
+            opt = "--hot-coverage";
+        else if (xg_flag_computed_goto)
+            opt = "--computed-goto";
+        else
+            return 0;
+
+        fprintf(stderr, "xg: ERROR: %s applies only to directly executable parsers\n", opt);
+        return -1;
+    }
+
+    if (xg_hot_coverage >= 0 && !xg_profile_name) {
+        fputs("xg: ERROR: --hot-coverage requires --profile\n", stderr);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 handle_non_option_arg(const char *arg) {
     if (xg_input)
@@ -175,6 +305,39 @@ static ulib_option options[]
         .value = output_lalr,
         .help = "\t\toutput a LALR(1) parser"},
 
+       {.key = 'b',
+        .name = "backend",
+        .cb = handle_backend,
+        .flags = ulib_option_required_arg,
+        .arg = "<name>",
+        .help = "\n\t\t\tgenerate a direct or a tables parser"},
+
+       {.key = 'p',
+        .name = "profile",
+        .cb = handle_profile,
+        .flags = ulib_option_required_arg,
+        .arg = "<path>",
+        .help = "\n\t\t\tgenerate direct code only for the hot states in the profile"},
+
+       {.key = 'H',
+        .name = "hot-coverage",
+        .cb = handle_hot_coverage,
+        .flags = ulib_option_required_arg,
+        .arg = "<percent>",
+        .help = "\n\t\t\tpercentage of the profiled state visits in hot states"},
+
+       {.key = 'I',
+        .name = "instrument",
+        .flag = &xg_flag_instrument,
+        .value = 1,
+        .help = "\tcount the state visits in the parser for profiling"},
+
+       {.key = 'G',
+        .name = "computed-goto",
+        .flag = &xg_flag_computed_goto,
+        .value = 1,
+        .help = "\tjump to the non-terminal transitions through label tables"},
+
        {.key = 's',
         .name = "sentence",
         .flag = &xg_flag_output_type,
@@ -188,6 +351,19 @@ static ulib_option options[]
         .arg = "<number>",
         .help = "\n\t\t\trandom sentence size"},
 
+       {.key = 'k',
+        .name = "kernel-only",
+        .flag = &xg_flag_kernel_only,
+        .value = 1,
+        .help = "\tstore only the kernel items of the LR(0) states"},
+
+       {.key = 'j',
+        .name = "jobs",
+        .cb = handle_jobs,
+        .flags = ulib_option_required_arg,
+        .arg = "<number>",
+        .help = "\n\t\t\tuse <number> threads to construct the parser"},
+
        {.key = 'c',
         .name = "codes",
         .flag = &xg_flag_token_codes,
@@ -203,57 +379,184 @@ static ulib_option options[]
         .arg = "<path>",
         .help = "\n\t\t\tproduce a report with details on the parser"},
 
-       {.key = 0, .cb = handle_non_option_arg}};
+       {.key = 'T',
+        .name = "stats",
+        .flag = &xg_flag_stats,
+        .value = 1,
+        .cb = handle_stats,
+        .flags = ulib_option_optional_arg,
+        .arg = "<format>",
+        .help = "\n\t\t\toutput phase times and counts as a table or json"},
 
-int
-main(int argc, const char *argv[]) {
-    int sts;
-    static ulib_log log;
-    xg_grammar *g = 0;
-    xg_lr0dfa *dfa = 0;
-    FILE *out;
+       {.key = 0, .cb = handle_non_option_arg}};
 
-    /* Create the message log.  */
-    xg_log = &log;
-    if (ulib_log_init(xg_log, "xg") < 0) {
-        fprintf(stderr, "xg: ERROR: unable to create the message log.\n");
+/* Passes of the generator, in the order of execution.  */
+enum pass_id {
+    pass_read,
+    pass_first,
+    pass_suffixes,
+    pass_follow,
+    pass_closure,
+    pass_lr0,
+    pass_slr,
+    pass_lalr,
+    pass_conflicts,
+    pass_output,
+    pass_report,
+    pass_count
+};
+
+/* Set of passes.  */
+#define PASS(id) (1U << (id))
+
+/* The results of the passes.  */
+struct pass_ctx {
+    xg_grammar *g;
+    xg_lr0dfa *dfa;
+};
+typedef struct pass_ctx pass_ctx;
+
+/* A pass of the generator.  */
+struct pass {
+    /* Pass name.  */
+    const char *name;
+
+    /* Passes, whose results this one needs.  Each of them precedes the
+       pass.  */
+    unsigned int deps;
+
+    /* Passes, whose results this one uses, if they are run for other
+       reasons.  */
+    unsigned int uses;
+
+    /* Run the pass.  Return negative on error.  */
+    int (*run)(pass_ctx *);
+
+    /* Release the results of the pass or null, if they are kept until
+       the end.  */
+    void (*release)(pass_ctx *);
+};
+typedef struct pass pass;
+
+/* Parse the input file.  */
+static int
+run_read(pass_ctx *ctx) {
+    if ((ctx->g = xg_grammar_read(xg_input)) == 0)
         return -1;
-    }
 
-    argv[0] = "xg";
-    if (ulib_options_parse(options, argc, argv, stderr) < 0)
-        return -1;
+    xg_stat_set(xg_stat_symbols, xg_grammar_symbol_count(ctx->g));
+    xg_stat_set(xg_stat_prods, xg_grammar_prod_count(ctx->g));
+    xg_stat_set(xg_stat_items, xg_grammar_item_count(ctx->g));
+    return 0;
+}
 
-    /* Check options sanity.  */
-    if (!xg_input) {
-        fputs("xg: ERROR: missing input file name\n", stderr);
+/* Compute FIRST sets.  */
+static int
+run_first(pass_ctx *ctx) {
+    return xg_grammar_compute_first(ctx->g);
+}
+
+static void
+release_first(pass_ctx *ctx) {
+    xg_grammar_release_first(ctx->g);
+}
+
+/* Compute the nullable flags and FIRST sets of the production
+   suffixes.  */
+static int
+run_suffixes(pass_ctx *ctx) {
+    return xg_grammar_compute_suffixes(ctx->g);
+}
+
+static void
+release_suffixes(pass_ctx *ctx) {
+    xg_grammar_release_suffixes(ctx->g);
+}
+
+/* Compute FOLLOW sets.  */
+static int
+run_follow(pass_ctx *ctx) {
+    return xg_grammar_compute_follow(ctx->g);
+}
+
+static void
+release_follow(pass_ctx *ctx) {
+    xg_grammar_release_follow(ctx->g);
+}
+
+/* Compute the LR(0) closure sets of the non-terminals.  */
+static int
+run_closure(pass_ctx *ctx) {
+    return xg_grammar_compute_lr0_closure(ctx->g);
+}
+
+static void
+release_closure(pass_ctx *ctx) {
+    xg_grammar_release_lr0_closure(ctx->g);
+}
+
+/* Create the LR(0) automaton.  */
+static int
+run_lr0(pass_ctx *ctx) {
+    if ((ctx->dfa = xg_lr0dfa_new(ctx->g, xg_flag_kernel_only, xg_jobs)) == 0)
         return -1;
-    }
 
-    /* Initialize memory management.  */
-    if (xg__init_grammar() < 0 || xg__init_lr0dfa() < 0 || xg__init_lalr() < 0)
-        goto error;
+    xg_stat_set(xg_stat_states, xg_lr0dfa_state_count(ctx->dfa));
+    xg_stat_set(xg_stat_trans, xg_lr0dfa_trans_count(ctx->dfa));
+    return 0;
+}
 
-    /* Parse the input file. */
-    if ((g = xg_grammar_read(xg_input)) == 0)
-        goto error;
+/* Compute the SLR(1) lookahead sets.  */
+static int
+run_slr(pass_ctx *ctx) {
+    return xg_make_slr_reductions(ctx->g, ctx->dfa);
+}
 
-    /* Compute FIRST and FOLLOW sets.  */
-    if (xg_grammar_compute_first(g) < 0 || xg_grammar_compute_follow(g) < 0)
-        goto error;
+/* Compute the LALR(1) lookahead sets.  */
+static int
+run_lalr(pass_ctx *ctx) {
+    return xg_make_lalr_reductions(ctx->g, ctx->dfa, xg_jobs);
+}
 
-    /* Create the parsing automaton.  */
-    if (xg_flag_output_type == output_slr || xg_flag_output_type == output_lalr) {
-        if ((dfa = xg_lr0dfa_new(g)) == 0)
-            goto error;
+/* Resolve the parsing conflicts.  */
+static int
+run_conflicts(pass_ctx *ctx) {
+    if (xg_resolve_conflicts(ctx->g, ctx->dfa) < 0)
+        return -1;
 
-        if ((xg_flag_output_type == output_slr && xg_make_slr_reductions(g, dfa) < 0)
-            || (xg_flag_output_type == output_lalr
-                && xg_make_lalr_reductions(g, dfa) < 0))
-            goto error;
+    /* Resolving the conflicts is the last pass to create lookahead
+       sets.  */
+    xg_stat_set(xg_stat_lasets, xg_laset_count());
+    return 0;
+}
 
-        xg_resolve_conflicts(g, dfa);
-    }
+/* Get the position in the output OUT, or negative if OUT is not a
+   regular file.  */
+static long
+output_position(FILE *out) {
+    struct stat st;
+
+    if (fstat(fileno(out), &st) < 0 || !S_ISREG(st.st_mode))
+        return -1;
+    return ftell(out);
+}
+
+/* Write the required output.  */
+static int
+run_output(pass_ctx *ctx) {
+    int sts = 0;
+    long start, end;
+    FILE *out;
+    xg_profile *prof = 0;
+    xg_gen_c_options opt;
+
+    /* Read the profile before creating the output.  */
+    if (xg_profile_name
+        && (prof = xg_profile_read(xg_profile_name,
+                                   xg_lr0dfa_state_count(ctx->dfa),
+                                   xg_grammar_prod_count(ctx->g)))
+               == 0)
+        return -1;
 
     /* Open the output file.  */
     if (xg_output == 0)
@@ -261,42 +564,176 @@ main(int argc, const char *argv[]) {
     else {
         if ((out = fopen(xg_output, "w")) == 0) {
             fprintf(stderr, "xg: ERROR: Cannot open output file  ``%s''\n", xg_output);
-            goto error;
+            xg_profile_del(prof);
+            return -1;
         }
     }
 
-    /* Write the required output.  */
+    start = output_position(out);
+
+    opt.prof = prof;
+    opt.coverage = xg_hot_coverage < 0 ? XG_HOT_COVERAGE_DEFAULT : xg_hot_coverage;
+    opt.instrument = xg_flag_instrument;
+    opt.computed_goto = xg_flag_computed_goto;
+
     if (xg_flag_output_type == output_random_sentence)
-        xg_make_random_sentence(out, g, xg_sentence_size, xg_flag_token_codes);
+        xg_make_random_sentence(out, ctx->g, xg_sentence_size, xg_flag_token_codes);
     else if (xg_flag_output_type == output_defines) {
+    } else if (xg_backend == backend_tables) {
+        if (xg_gen_c_tables(out, ctx->g, ctx->dfa, &opt) < 0 && xg_output != 0)
+            sts = -1;
     } else {
-        if (xg_gen_c_parser(out, g, dfa) < 0) {
-            if (xg_output != 0) {
-                fclose(out);
-                goto error;
-            }
-        }
+        if (xg_gen_c_parser(out, ctx->g, ctx->dfa, &opt) < 0 && xg_output != 0)
+            sts = -1;
     }
 
+    /* The size of the output is known only for regular files.  */
+    if (start >= 0 && (end = ftell(out)) >= start)
+        xg_stat_set(xg_stat_output_bytes, end - start);
     if (xg_output)
         fclose(out);
+    xg_profile_del(prof);
 
-    /* Report details about the parser.  */
-    if (xg_flag_report) {
-        if (xg_report) {
-            if ((out = fopen(xg_report, "w")) == 0)
-                goto error;
-        } else
-            out = stderr;
+    return sts;
+}
+
+/* Report details about the parser.  */
+static int
+run_report(pass_ctx *ctx) {
+    FILE *out;
+
+    if (xg_report) {
+        if ((out = fopen(xg_report, "w")) == 0)
+            return -1;
+    } else
+        out = stderr;
+
+    xg_grammar_debug(out, ctx->g);
+    if (ctx->dfa)
+        xg_lr0dfa_debug(out, ctx->g, ctx->dfa);
 
-        xg_grammar_debug(out, g);
-        if (dfa)
-            xg_lr0dfa_debug(out, g, dfa);
+    if (xg_report)
+        fclose(out);
+
+    return 0;
+}
+
+/* All the passes.  */
+static const pass passes[pass_count] = {
+    [pass_read] = {"read", 0, 0, run_read, 0},
+    [pass_first] = {"first", PASS(pass_read), 0, run_first, release_first},
+    [pass_suffixes] = {"suffixes", PASS(pass_first), 0, run_suffixes, release_suffixes},
+    [pass_follow] = {"follow",
+                     PASS(pass_first) | PASS(pass_suffixes),
+                     0,
+                     run_follow,
+                     release_follow},
+    [pass_closure] = {"closure", PASS(pass_read), 0, run_closure, release_closure},
+    [pass_lr0] = {"lr0", PASS(pass_closure), 0, run_lr0, 0},
+    [pass_slr] = {"slr", PASS(pass_closure) | PASS(pass_lr0) | PASS(pass_follow), 0, run_slr, 0},
+    [pass_lalr] = {"lalr",
+                   PASS(pass_first) | PASS(pass_suffixes) | PASS(pass_closure) | PASS(pass_lr0),
+                   0,
+                   run_lalr,
+                   0},
+    [pass_conflicts] = {"conflicts", PASS(pass_lr0), 0, run_conflicts, 0},
+    [pass_output] = {"output", PASS(pass_read), PASS(pass_lr0), run_output, 0},
+    [pass_report] = {"report",
+                     PASS(pass_first) | PASS(pass_follow),
+                     PASS(pass_closure) | PASS(pass_lr0),
+                     run_report,
+                     0},
+};
+
+/* Get the passes, needed for the requested output: the ones, producing
+   the output, and all of their dependencies.  */
+static unsigned int
+needed_passes(void) {
+    unsigned int i, need;
+
+    need = PASS(pass_output);
+    if (xg_flag_output_type == output_slr)
+        need |= PASS(pass_slr) | PASS(pass_conflicts);
+    else if (xg_flag_output_type == output_lalr)
+        need |= PASS(pass_lalr) | PASS(pass_conflicts);
+    if (xg_flag_report)
+        need |= PASS(pass_report);
+
+    /* The dependencies precede the pass, so a single backward sweep
+       finds them all.  */
+    for (i = pass_count; i-- > 0;)
+        if (need & PASS(i))
+            need |= passes[i].deps;
+
+    return need;
+}
 
-        if (xg_report)
-            fclose(out);
+/* Run the passes in the set NEED, in order, and record the time spent
+   in each one.  After each pass, release the results, which none of
+   the remaining passes uses.  */
+static int
+run_passes(pass_ctx *ctx, unsigned int need) {
+    unsigned int i, j, live;
+    xg_stats_time start;
+
+    for (i = 0; i < pass_count; ++i) {
+        if (!(need & PASS(i)))
+            continue;
+
+        start = xg_stats_now();
+        if (passes[i].run(ctx) < 0)
+            return -1;
+        xg_stats_phase(passes[i].name, start);
+
+        live = 0;
+        for (j = i + 1; j < pass_count; ++j)
+            if (need & PASS(j))
+                live |= passes[j].deps | passes[j].uses;
+
+        for (j = 0; j <= i; ++j) {
+            if ((need & PASS(j)) && !(live & PASS(j)) && passes[j].release) {
+                passes[j].release(ctx);
+                need &= ~PASS(j);
+            }
+        }
     }
 
+    return 0;
+}
+
+int
+main(int argc, const char *argv[]) {
+    int sts;
+    static ulib_log log;
+    pass_ctx ctx = {0, 0};
+
+    /* Create the message log.  */
+    xg_log = &log;
+    if (ulib_log_init(xg_log, "xg") < 0) {
+        fprintf(stderr, "xg: ERROR: unable to create the message log.\n");
+        return -1;
+    }
+
+    argv[0] = "xg";
+    if (ulib_options_parse(options, argc, argv, stderr) < 0)
+        return -1;
+
+    /* Check options sanity.  */
+    if (!xg_input) {
+        fputs("xg: ERROR: missing input file name\n", stderr);
+        return -1;
+    }
+    if (check_output_options() < 0)
+        return -1;
+
+    /* Initialize memory management.  */
+    if (xg__init_grammar() < 0 || xg__init_lr0dfa() < 0 || xg__init_laset() < 0)
+        goto error;
+
+    /* Run the passes, needed for the requested output.  */
+    if (run_passes(&ctx, needed_passes()) < 0)
+        goto error;
+
     sts = 0;
     goto exit;
 
@@ -305,13 +742,16 @@ error:
     if (xg_output)
         remove(xg_output);
 exit:
-    if (dfa)
-        xg_lr0dfa_del(dfa);
+    if (ctx.dfa)
+        xg_lr0dfa_del(ctx.dfa);
 
-    if (g)
-        xg_grammar_del(g);
+    if (ctx.g)
+        xg_grammar_del(ctx.g);
     ulib_gcrun();
 
+    if (xg_flag_stats)
+        xg_stats_print(stderr, xg_stats_format);
+
     ulib_log_write(xg_log, stderr);
     ulib_log_destroy(xg_log);
     return sts;
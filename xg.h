@@ -22,6 +22,7 @@
 #define xg__xg_h 1
 
 #include <ulib/log.h>
+#include <pthread.h>
 #include <stdlib.h>
 
 BEGIN_DECLS
@@ -29,14 +30,60 @@ BEGIN_DECLS
 /* XG message log.  */
 extern ulib_log *xg_log;
 
-/* Logging memory allocation functions.  */
-void *xg_malloc(size_t);
-void *xg_calloc(size_t, size_t);
-void *xg_realloc(void *, size_t);
-static inline void
-xg_free(void *ptr) {
-    free(ptr);
-}
+/* Lock, serializing the access to the message log.  */
+extern pthread_mutex_t xg_log_lock;
+
+/* Append a message to the message log.  Unlike ULIB_LOG_PRINTF, it may
+   be used from several threads at once.  */
+#define xg_log_printf(...)                          \
+    do {                                            \
+        pthread_mutex_lock(&xg_log_lock);           \
+        ulib_log_printf(xg_log, __VA_ARGS__);       \
+        pthread_mutex_unlock(&xg_log_lock);         \
+    } while (0)
+
+/* Memory accounting tags: the subsystem, which owns a block.  */
+enum xg_mem_tag {
+    xg_mem_misc,
+    xg_mem_parse,
+    xg_mem_grammar,
+    xg_mem_symdef,
+    xg_mem_prod,
+    xg_mem_sets,
+    xg_mem_lr0state,
+    xg_mem_lr0dfa,
+    xg_mem_laset,
+    xg_mem_lalr,
+    xg_mem_relation,
+    xg_mem_output,
+    xg_mem_tag_count
+};
+
+/* Logging and accounting memory allocation functions.  The blocks must
+   be released with XG_FREE.  */
+void *xg_malloc(enum xg_mem_tag, size_t);
+void *xg_calloc(enum xg_mem_tag, size_t, size_t);
+void *xg_realloc(enum xg_mem_tag, void *, size_t);
+void xg_free(void *);
+
+/* Account SZ bytes of an object, allocated outside of XG_MALLOC, as
+   allocated (SZ > 0) or released (SZ < 0).  */
+void xg_mem_account(enum xg_mem_tag, long sz);
+
+/* Memory usage of a tag.  */
+struct xg_mem_usage {
+    size_t live;
+    size_t peak;
+    unsigned long count;
+};
+typedef struct xg_mem_usage xg_mem_usage;
+
+/* Get the memory usage of TAG or, if TAG is XG_MEM_TAG_COUNT, of all
+   the tags together.  */
+xg_mem_usage xg_mem_get_usage(enum xg_mem_tag tag);
+
+/* Get the name of TAG.  */
+const char *xg_mem_tag_name(enum xg_mem_tag tag);
 
 END_DECLS
 